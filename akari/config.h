@@ -13,3 +13,8 @@
 #define CONFIG_CCSECURITY_MISC
 #define CONFIG_CCSECURITY_TASK_EXECUTE_HANDLER
 #define CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+#define CONFIG_CCSECURITY_HOT_ACL
+#define CONFIG_CCSECURITY_ACL_TABLE
+//#define CONFIG_CCSECURITY_ACL_PROFILE
+#define CONFIG_CCSECURITY_LATENCY
+#define CONFIG_CCSECURITY_TRACEPOINT
@@ -15,10 +15,12 @@
 #define for_each_process for_each_task
 #endif
 
-/* The list for "struct ccs_io_buffer". */
-static LIST_HEAD(ccs_io_buffer_list);
-/* Lock for protecting ccs_io_buffer_list. */
-static DEFINE_SPINLOCK(ccs_io_buffer_list_lock);
+/* Size of hash table for "struct ccs_io_pin". */
+#define CCS_IO_PIN_HASH_BITS 6
+#define CCS_MAX_IO_PIN_HASH (1u << CCS_IO_PIN_HASH_BITS)
+
+/* Max number of elements which wait for one SRCU grace period together. */
+#define CCS_GC_BATCH_SIZE 512
 
 /***** SECTION2: Structure definition *****/
 
@@ -37,34 +39,86 @@ struct ccs_lock_struct {
 
 #endif
 
+/* Structure for an element which is waiting for SRCU grace period. */
+struct ccs_gc_entry {
+	struct list_head *element;
+	/* List which @element was on if the list may have an index. */
+	const struct list_head *owner;
+	enum ccs_policy_id type;
+	bool in_use; /* True if @element has to be reinjected. */
+};
+
 /***** SECTION3: Prototype definition section *****/
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 19)
 int ccs_lock(void);
 #endif
+int ccs_pin_cursor(struct ccs_io_buffer *head);
+int ccs_unlock_cursor(struct ccs_io_buffer *head);
 void ccs_del_acl(struct list_head *element);
 void ccs_del_condition(struct list_head *element);
+void __init ccs_gc_init(void);
+void ccs_lock_cursor(void);
+void ccs_mark_garbage(struct ccs_policy_namespace *ns, struct list_head *list,
+		      const bool is_acl);
 void ccs_notify_gc(struct ccs_io_buffer *head, const bool is_register);
+void ccs_schedule_gc(void);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 19)
 void ccs_unlock(const int idx);
 #endif
 
 static bool ccs_domain_used_by_task(struct ccs_domain_info *domain);
-static bool ccs_name_used_by_io_buffer(const char *string, const size_t size);
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+static bool ccs_has_auto_transition(const struct list_head *list);
+#endif
+static bool ccs_release_entry(const enum ccs_policy_id type,
+			      struct list_head *element);
 static bool ccs_struct_used_by_io_buffer(const struct list_head *element);
-static int ccs_gc_thread(void *unused);
+static int ccs_copy_words(struct ccs_io_buffer *head);
 static void ccs_collect_acl(struct list_head *list);
 static void ccs_collect_entry(void);
 static void ccs_collect_member(const enum ccs_policy_id id,
 			       struct list_head *member_list);
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+static void ccs_recheck_auto_transition(void);
+#endif
+static void ccs_flush_gc(void);
 static void ccs_memory_free(const void *ptr, const enum ccs_policy_id type);
 static void ccs_put_name_union(struct ccs_name_union *ptr);
 static void ccs_put_number_union(struct ccs_number_union *ptr);
+static void ccs_rebuild_index(void);
+static void ccs_rebuild_ranges(void);
+static void ccs_release_index(struct ccs_domain_index *stale);
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+static struct ccs_hot_acl *ccs_build_hot_acl
+(const struct ccs_domain_info *domain);
+static void ccs_decay_hits(struct list_head *list);
+static u32 ccs_sum_hits(const struct ccs_acl_info *ptr);
+static void ccs_reorder_acl(void);
+#endif
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+static struct ccs_acl_table *ccs_build_acl_table(const struct list_head *list,
+						 const unsigned int generation);
+static void ccs_collect_acl_table(const struct list_head *list, u32 *count,
+				  struct ccs_acl_table *table);
+static void ccs_compile_acl(void);
+static void ccs_compile_list(const struct list_head *list,
+			     struct ccs_acl_table **tablep,
+			     const unsigned int generation,
+			     struct ccs_acl_table **stale);
+static void ccs_free_acl_table(struct ccs_acl_table *table);
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 20)
+static void ccs_run_gc(struct work_struct *unused);
+#else
+static void ccs_run_gc(void *unused);
+#endif
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 19)
 static void ccs_synchronize_counter(void);
 #endif
 static void ccs_try_to_gc(const enum ccs_policy_id type,
-			  struct list_head *element);
+			  struct list_head *element,
+			  const struct list_head *owner);
 
 /***** SECTION4: Standalone functions section *****/
 
@@ -87,6 +141,35 @@ static DEFINE_SPINLOCK(ccs_counter_lock);
 
 #endif
 
+/*
+ * Elements unlinked by ccs_try_to_gc() and not yet released by
+ * ccs_flush_gc(). Accessed by only the garbage collector thread.
+ */
+static struct ccs_gc_entry ccs_gc_queue[CCS_GC_BATCH_SIZE];
+/* Number of elements in ccs_gc_queue. */
+static unsigned int ccs_gc_queue_len;
+
+/* Cursors of "struct ccs_io_buffer" which are parked on list elements. */
+static struct list_head ccs_io_pin_list[CCS_MAX_IO_PIN_HASH];
+/* Lock for protecting ccs_io_pin_list[]. */
+static DEFINE_SPINLOCK(ccs_io_pin_lock);
+/*
+ * Lock for excluding /proc/ccs/ users while the garbage collector checks
+ * ccs_io_pin_list[], for they might be walking from a pinned element which
+ * was already unlinked.
+ */
+static DECLARE_RWSEM(ccs_io_cursor_sem);
+
+/* Bitmap of "enum ccs_gc_dirty_index" which the garbage collector visits. */
+unsigned long ccs_gc_dirty;
+
+/* The garbage collector, which is queued when ccs_gc_dirty is not 0. */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 20)
+static DECLARE_WORK(ccs_gc_work, ccs_run_gc);
+#else
+static DECLARE_WORK(ccs_gc_work, ccs_run_gc, NULL);
+#endif
+
 /***** SECTION6: Dependent functions section *****/
 
 /**
@@ -160,9 +243,11 @@ static void ccs_memory_free(const void *ptr, const enum ccs_policy_id type)
 	else if (type == CCS_ID_NAME)
 		size = container_of(ptr, typeof(struct ccs_name),
 				    head.list)->size;
-	else if (type == CCS_ID_CONDITION)
-		size = container_of(ptr, typeof(struct ccs_condition),
-				    head.list)->size;
+	else if (type == CCS_ID_CONDITION) {
+		const struct ccs_condition *cond =
+			container_of(ptr, typeof(*cond), head.list);
+		size = cond->size + cond->opc * sizeof(struct ccs_condition_op);
+	}
 	else
 		size = e[type];
 	ccs_memory_used[CCS_MEMORY_POLICY] -= ccs_round2(size);
@@ -200,62 +285,152 @@ static void ccs_put_number_union(struct ccs_number_union *ptr)
  * @element: Pointer to "struct list_head".
  *
  * Returns true if @element is used by /proc/ccs/ users, false otherwise.
+ *
+ * Caller holds ccs_io_cursor_sem for writing.
  */
 static bool ccs_struct_used_by_io_buffer(const struct list_head *element)
 {
-	struct ccs_io_buffer *head;
+	struct ccs_io_pin *pin;
 	bool in_use = false;
-	spin_lock(&ccs_io_buffer_list_lock);
-	list_for_each_entry(head, &ccs_io_buffer_list, list) {
-		head->users++;
-		spin_unlock(&ccs_io_buffer_list_lock);
-		mutex_lock(&head->io_sem);
-		if (head->r.domain == element || head->r.group == element ||
-		    head->r.acl == element || &head->w.domain->list == element)
-			in_use = true;
-		mutex_unlock(&head->io_sem);
-		spin_lock(&ccs_io_buffer_list_lock);
-		head->users--;
-		if (in_use)
-			break;
+	spin_lock(&ccs_io_pin_lock);
+	list_for_each_entry(pin, &ccs_io_pin_list
+			    [hash_ptr((void *) element, CCS_IO_PIN_HASH_BITS)],
+			    list) {
+		if (pin->element != element)
+			continue;
+		in_use = true;
+		break;
 	}
-	spin_unlock(&ccs_io_buffer_list_lock);
+	spin_unlock(&ccs_io_pin_lock);
 	return in_use;
 }
 
 /**
- * ccs_name_used_by_io_buffer - Check whether the string is used by /proc/ccs/ users or not.
+ * ccs_copy_words - Copy words which are not yet copied to userspace.
+ *
+ * @head: Pointer to "struct ccs_io_buffer".
+ *
+ * Returns 0 on success, -ENOMEM otherwise.
  *
- * @string: String to check.
- * @size:   Memory allocated for @string .
+ * Words queued by ccs_set_string() may point to "struct ccs_name" which GC
+ * can kfree() after this read() request finished. Since such words remain
+ * only when the userspace buffer became full, copying them is cheaper than
+ * letting GC check all "struct ccs_io_buffer"->r.w[].
  *
- * Returns true if @string is used by /proc/ccs/ users, false otherwise.
+ * If copying failed, the words are forgotten and reading stops, so that the
+ * reader gets an error rather than a line with missing words.
  */
-static bool ccs_name_used_by_io_buffer(const char *string, const size_t size)
+static int ccs_copy_words(struct ccs_io_buffer *head)
 {
-	struct ccs_io_buffer *head;
-	bool in_use = false;
-	spin_lock(&ccs_io_buffer_list_lock);
-	list_for_each_entry(head, &ccs_io_buffer_list, list) {
-		int i;
-		head->users++;
-		spin_unlock(&ccs_io_buffer_list_lock);
-		mutex_lock(&head->io_sem);
-		for (i = 0; i < CCS_MAX_IO_READ_QUEUE; i++) {
-			const char *w = head->r.w[i];
-			if (w < string || w > string + size)
-				continue;
-			in_use = true;
-			break;
-		}
-		mutex_unlock(&head->io_sem);
-		spin_lock(&ccs_io_buffer_list_lock);
-		head->users--;
-		if (in_use)
-			break;
+	const char *buf = head->read_buf;
+	const char *old = head->w_copy;
+	char *cp;
+	size_t len = 0;
+	bool copy = false;
+	u8 i;
+	for (i = 0; i < head->r.w_pos; i++) {
+		const char *w = head->r.w[i];
+		if (w >= buf && w < buf + head->readbuf_size)
+			continue;
+		len += strlen(w) + 1;
+		if (w < old || w >= old + head->w_copy_size)
+			copy = true;
 	}
-	spin_unlock(&ccs_io_buffer_list_lock);
-	return in_use;
+	if (!copy)
+		return 0;
+	cp = kzalloc(len, CCS_GFP_FLAGS);
+	if (!cp) {
+		head->r.w_pos = 0;
+		head->r.eof = true;
+		return -ENOMEM;
+	}
+	head->w_copy = cp;
+	head->w_copy_size = len;
+	for (i = 0; i < head->r.w_pos; i++) {
+		const char *w = head->r.w[i];
+		if (w >= buf && w < buf + head->readbuf_size)
+			continue;
+		len = strlen(w) + 1;
+		memcpy(cp, w, len);
+		head->r.w[i] = cp;
+		cp += len;
+	}
+	kfree(old);
+	return 0;
+}
+
+/**
+ * ccs_lock_cursor - Start resuming from cursors of "struct ccs_io_buffer".
+ *
+ * Returns nothing.
+ *
+ * Needed only while walking lists from pinned cursors, which might point to
+ * elements already unlinked. Callers which only assign cursors to elements
+ * found under ccs_read_lock() may call ccs_pin_cursor() instead.
+ *
+ * Caller holds "struct ccs_io_buffer"->io_sem and ccs_read_lock().
+ */
+void ccs_lock_cursor(void)
+{
+	down_read(&ccs_io_cursor_sem);
+}
+
+/**
+ * ccs_pin_cursor - Pin cursors of "struct ccs_io_buffer".
+ *
+ * @head: Pointer to "struct ccs_io_buffer".
+ *
+ * Returns 0 on success, -ENOMEM otherwise.
+ *
+ * Pins are updated before ccs_read_unlock(). Thus, the garbage collector,
+ * which checks pins after an SRCU grace period, sees new cursors even if
+ * ccs_io_cursor_sem is not held.
+ *
+ * Caller holds "struct ccs_io_buffer"->io_sem and ccs_read_lock().
+ */
+int ccs_pin_cursor(struct ccs_io_buffer *head)
+{
+	const struct list_head *cursor[CCS_MAX_IO_PIN] = {
+		[CCS_PIN_READ_DOMAIN] = head->r.domain,
+		[CCS_PIN_READ_GROUP] = head->r.group,
+		[CCS_PIN_READ_ACL] = head->r.acl,
+		[CCS_PIN_WRITE_DOMAIN] =
+		head->w.domain ? &head->w.domain->list : NULL,
+	};
+	const int error = ccs_copy_words(head);
+	u8 i;
+	spin_lock(&ccs_io_pin_lock);
+	for (i = 0; i < CCS_MAX_IO_PIN; i++) {
+		struct ccs_io_pin *pin = &head->pin[i];
+		if (pin->element == cursor[i])
+			continue;
+		if (pin->element)
+			list_del(&pin->list);
+		pin->element = cursor[i];
+		if (cursor[i])
+			list_add(&pin->list, &ccs_io_pin_list
+				 [hash_ptr((void *) cursor[i],
+					   CCS_IO_PIN_HASH_BITS)]);
+	}
+	spin_unlock(&ccs_io_pin_lock);
+	return error;
+}
+
+/**
+ * ccs_unlock_cursor - Pin cursors of "struct ccs_io_buffer" and stop resuming.
+ *
+ * @head: Pointer to "struct ccs_io_buffer".
+ *
+ * Returns 0 on success, -ENOMEM otherwise.
+ *
+ * Caller holds "struct ccs_io_buffer"->io_sem, ccs_read_lock() and
+ * ccs_lock_cursor().
+ */
+int ccs_unlock_cursor(struct ccs_io_buffer *head)
+{
+	const int error = ccs_pin_cursor(head);
+	up_read(&ccs_io_cursor_sem);
+	return error;
 }
 
 /**
@@ -312,6 +487,15 @@ static inline void ccs_del_manager(struct list_head *element)
 static bool ccs_domain_used_by_task(struct ccs_domain_info *domain)
 {
 	bool in_use = false;
+#ifdef CONFIG_CCSECURITY_USE_EXTERNAL_TASK_SECURITY
+	/*
+	 * Every "struct ccs_security" holds a reference to its domain, and
+	 * "struct ccs_execve" holds a reference to the domain which
+	 * ccs_finish_execve() might revert to. Thus, we need not scan
+	 * ccs_task_security_list.
+	 */
+	in_use = atomic_read(&domain->users) > 0;
+#else
 	/*
 	 * Don't delete this domain if somebody is doing execve().
 	 *
@@ -319,26 +503,7 @@ static bool ccs_domain_used_by_task(struct ccs_domain_info *domain)
 	 * updates ccs_flags, we need smp_rmb() to make sure that GC first
 	 * checks ccs_flags and then checks ccs_domain_info.
 	 */
-#ifdef CONFIG_CCSECURITY_USE_EXTERNAL_TASK_SECURITY
-	int idx;
-	rcu_read_lock();
-	for (idx = 0; idx < CCS_MAX_TASK_SECURITY_HASH; idx++) {
-		struct ccs_security *ptr;
-		struct list_head *list = &ccs_task_security_list[idx];
-		list_for_each_entry_rcu(ptr, list, list) {
-			if (!(ptr->ccs_flags & CCS_TASK_IS_IN_EXECVE)) {
-				smp_rmb(); /* Avoid out of order execution. */
-				if (ptr->ccs_domain_info != domain)
-					continue;
-			}
-			in_use = true;
-			goto out;
-		}
-	}
-	in_use = ccs_used_by_cred(domain);
-out:
-	rcu_read_unlock();
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3, 14, 0) || defined(for_each_process_thread)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 14, 0) || defined(for_each_process_thread)
 	struct task_struct *g;
 	struct task_struct *t;
 	rcu_read_lock();
@@ -383,6 +548,7 @@ out:
 		break;
 	}
 	read_unlock(&tasklist_lock);
+#endif
 #endif
 	return in_use;
 }
@@ -398,6 +564,14 @@ void ccs_del_acl(struct list_head *element)
 {
 	struct ccs_acl_info *acl = container_of(element, typeof(*acl), list);
 	ccs_put_condition(acl->cond);
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+	if (acl->hits)
+		free_percpu(acl->hits);
+#endif
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+	if (acl->profile)
+		free_percpu(acl->profile);
+#endif
 	switch (acl->type) {
 	case CCS_TYPE_PATH_ACL:
 		{
@@ -523,15 +697,31 @@ static inline void ccs_del_domain(struct list_head *element)
 		container_of(element, typeof(*domain), list);
 	struct ccs_acl_info *acl;
 	struct ccs_acl_info *tmp;
+	u8 i;
 	/*
 	 * Since this domain is referenced from neither "struct ccs_io_buffer"
 	 * nor "struct task_struct", we can delete elements without checking
 	 * for is_deleted flag.
 	 */
+	ccs_forget_dedup_index(&domain->acl_info_list);
 	list_for_each_entry_safe(acl, tmp, &domain->acl_info_list, list) {
 		ccs_del_acl(&acl->list);
 		ccs_memory_free(acl, CCS_ID_ACL);
 	}
+	for (i = 0; i < CCS_MAX_DOMAIN_INDEX; i++) {
+		if (!domain->index[i])
+			continue;
+		ccs_memory_used[CCS_MEMORY_POLICY] -= domain->index[i]->size;
+		kfree(domain->index[i]);
+	}
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+	kfree(domain->hot_acl);
+#endif
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+	if (domain->acl_table)
+		ccs_memory_used[CCS_MEMORY_POLICY] -= domain->acl_table->size;
+	ccs_free_acl_table(domain->acl_table);
+#endif
 	ccs_put_name(domain->domainname);
 }
 
@@ -560,6 +750,10 @@ static inline void ccs_del_group(struct list_head *element)
 {
 	struct ccs_group *group =
 		container_of(element, typeof(*group), head.list);
+	if (group->ranges) {
+		ccs_memory_used[CCS_MEMORY_POLICY] -= group->ranges->size;
+		kfree(group->ranges);
+	}
 	ccs_put_name(group->group_name);
 }
 
@@ -637,6 +831,7 @@ void ccs_del_condition(struct list_head *element)
 		ccs_put_name(envp->value);
 	}
 	ccs_put_name(cond->transit);
+	kfree(cond->ops);
 }
 
 /**
@@ -715,40 +910,30 @@ static void ccs_synchronize_counter(void)
 #endif
 
 /**
- * ccs_try_to_gc - Try to kfree() an entry.
+ * ccs_release_entry - Release members of an entry which is no longer reachable.
  *
  * @type:    One of values in "enum ccs_policy_id".
  * @element: Pointer to "struct list_head".
  *
- * Returns nothing.
+ * Returns true if @element can be kfree()d, false if @element is still in use.
  *
- * Caller holds ccs_policy_lock mutex.
+ * Caller must not hold ccs_policy_lock mutex.
  */
-static void ccs_try_to_gc(const enum ccs_policy_id type,
-			  struct list_head *element)
+static bool ccs_release_entry(const enum ccs_policy_id type,
+			      struct list_head *element)
 {
 	/*
-	 * __list_del_entry() guarantees that the list element became no longer
-	 * reachable from the list which the element was originally on (e.g.
-	 * ccs_domain_list). Also, synchronize_srcu() guarantees that the list
-	 * element became no longer referenced by syscall users.
-	 */
-	__list_del_entry(element);
-	mutex_unlock(&ccs_policy_lock);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 19)
-	synchronize_srcu(&ccs_ss);
-#else
-	ccs_synchronize_counter();
-#endif
-	/*
-	 * However, there are two users which may still be using the list
-	 * element. We need to defer until both users forget this element.
+	 * There are two users which may still be using the list element
+	 * after SRCU grace period. We need to defer until both users forget
+	 * this element.
 	 *
 	 * Don't kfree() until "struct ccs_io_buffer"->r.{domain,group,acl} and
 	 * "struct ccs_io_buffer"->w.domain forget this element.
+	 * "struct ccs_io_buffer"->r.w[] never refer this element, for
+	 * ccs_unlock_cursor() copies them.
 	 */
 	if (ccs_struct_used_by_io_buffer(element))
-		goto reinject;
+		return false;
 	switch (type) {
 	case CCS_ID_TRANSITION_CONTROL:
 		ccs_del_transition_control(element);
@@ -782,16 +967,6 @@ static void ccs_try_to_gc(const enum ccs_policy_id type,
 		ccs_del_condition(element);
 		break;
 	case CCS_ID_NAME:
-		/*
-		 * Don't kfree() until all "struct ccs_io_buffer"->r.w[] forget
-		 * this element.
-		 */
-		if (ccs_name_used_by_io_buffer
-		    (container_of(element, typeof(struct ccs_name),
-				  head.list)->entry.name,
-		     container_of(element, typeof(struct ccs_name),
-				  head.list)->size))
-			goto reinject;
 		ccs_del_name(element);
 		break;
 	case CCS_ID_ACL:
@@ -805,27 +980,134 @@ static void ccs_try_to_gc(const enum ccs_policy_id type,
 		if (ccs_domain_used_by_task
 		    (container_of(element, typeof(struct ccs_domain_info),
 				  list)))
-			goto reinject;
+			return false;
 		break;
 	case CCS_MAX_POLICY:
 		break;
 	}
-	mutex_lock(&ccs_policy_lock);
-	if (type == CCS_ID_DOMAIN)
-		ccs_del_domain(element);
-	ccs_memory_free(element, type);
-	return;
-reinject:
+	return true;
+}
+
+/**
+ * ccs_flush_gc - kfree() entries unlinked by ccs_try_to_gc().
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ *
+ * All queued elements share one SRCU grace period, for waiting for a grace
+ * period per an element makes deleting a large policy take minutes.
+ */
+static void ccs_flush_gc(void)
+{
+	unsigned int i;
+	if (!ccs_gc_queue_len)
+		return;
+	ccs_add_stat(perf[CCS_STAT_GC_BATCHES], 1);
+	ccs_add_stat(perf[CCS_STAT_GC_ELEMENTS], ccs_gc_queue_len);
+	mutex_unlock(&ccs_policy_lock);
 	/*
-	 * We can safely reinject this element here bacause
-	 * (1) Appending list elements and removing list elements are protected
-	 *     by ccs_policy_lock mutex.
-	 * (2) Only this function removes list elements and this function is
-	 *     exclusively executed by ccs_gc_mutex mutex.
-	 * are true.
+	 * synchronize_srcu() guarantees that the unlinked list elements
+	 * became no longer referenced by syscall users.
 	 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 19)
+	synchronize_srcu(&ccs_ss);
+#else
+	ccs_synchronize_counter();
+#endif
+	down_write(&ccs_io_cursor_sem);
+	for (i = 0; i < ccs_gc_queue_len; i++)
+		ccs_gc_queue[i].in_use =
+			!ccs_release_entry(ccs_gc_queue[i].type,
+					   ccs_gc_queue[i].element);
+	up_write(&ccs_io_cursor_sem);
 	mutex_lock(&ccs_policy_lock);
-	list_add_rcu(element, element->prev);
+	/*
+	 * Indexes of the lists which queued elements were on point to elements
+	 * which are kfree()d below, and do not know elements which are
+	 * reinjected below. Elements from the same list are queued in a row,
+	 * thus each index is dropped once per batch.
+	 */
+	for (i = 0; i < ccs_gc_queue_len; i++) {
+		const struct list_head *owner = ccs_gc_queue[i].owner;
+		if (owner && (!i || owner != ccs_gc_queue[i - 1].owner))
+			ccs_forget_dedup_index(owner);
+	}
+	/*
+	 * Walk in reverse order so that elements which were adjacent on the
+	 * same list are reinjected in their original order, for they share
+	 * the same "prev" element.
+	 */
+	i = ccs_gc_queue_len;
+	while (i--) {
+		struct list_head *element = ccs_gc_queue[i].element;
+		const enum ccs_policy_id type = ccs_gc_queue[i].type;
+		if (ccs_gc_queue[i].in_use) {
+			/* Retry upon next run. */
+			set_bit(CCS_GC_DIRTY_RESCAN, &ccs_gc_dirty);
+			/*
+			 * We can safely reinject this element here bacause
+			 * (1) Appending list elements and removing list
+			 *     elements are protected by ccs_policy_lock mutex.
+			 * (2) Only ccs_try_to_gc() removes list elements and
+			 *     ccs_try_to_gc() is exclusively executed by
+			 *     ccs_gc_mutex mutex.
+			 * (3) "prev" element was not unlinked after @element
+			 *     was unlinked, for ccs_collect_entry() calls
+			 *     ccs_flush_gc() before unlinking containers.
+			 * are true.
+			 */
+			list_add_rcu(element, element->prev);
+			/*
+			 * ccs_collect_member() and ccs_collect_acl() pick
+			 * up only entries marked as deleted.
+			 */
+			if (type == CCS_ID_ACL)
+				container_of(element, struct ccs_acl_info,
+					     list)->is_deleted = true;
+			else if (ccs_gc_queue[i].owner)
+				container_of(element, struct ccs_acl_head,
+					     list)->is_deleted = true;
+			continue;
+		}
+		if (type == CCS_ID_DOMAIN)
+			ccs_del_domain(element);
+		else if (type == CCS_ID_GROUP)
+			ccs_forget_dedup_index(&container_of
+					       (element, struct ccs_group,
+						head.list)->member_list);
+		ccs_memory_free(element, type);
+	}
+	ccs_gc_queue_len = 0;
+}
+
+/**
+ * ccs_try_to_gc - Try to kfree() an entry.
+ *
+ * @type:    One of values in "enum ccs_policy_id".
+ * @element: Pointer to "struct list_head".
+ * @owner:   Pointer to "struct list_head" which @element is on if the list
+ *           may have "struct ccs_dedup_index", NULL otherwise.
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_try_to_gc(const enum ccs_policy_id type,
+			  struct list_head *element,
+			  const struct list_head *owner)
+{
+	/*
+	 * __list_del_entry() guarantees that the list element became no longer
+	 * reachable from the list which the element was originally on (e.g.
+	 * ccs_domain_list). The element is kfree()d by ccs_flush_gc().
+	 */
+	__list_del_entry(element);
+	ccs_gc_queue[ccs_gc_queue_len].element = element;
+	ccs_gc_queue[ccs_gc_queue_len].owner = owner;
+	ccs_gc_queue[ccs_gc_queue_len].type = type;
+	if (++ccs_gc_queue_len == CCS_GC_BATCH_SIZE)
+		ccs_flush_gc();
 }
 
 /**
@@ -844,10 +1126,10 @@ static void ccs_collect_member(const enum ccs_policy_id id,
 	struct ccs_acl_head *member;
 	struct ccs_acl_head *tmp;
 	list_for_each_entry_safe(member, tmp, member_list, list) {
-		if (!member->is_deleted)
+		if (member->is_deleted != true)
 			continue;
 		member->is_deleted = CCS_GC_IN_PROGRESS;
-		ccs_try_to_gc(id, &member->list);
+		ccs_try_to_gc(id, &member->list, member_list);
 	}
 }
 
@@ -865,13 +1147,68 @@ static void ccs_collect_acl(struct list_head *list)
 	struct ccs_acl_info *acl;
 	struct ccs_acl_info *tmp;
 	list_for_each_entry_safe(acl, tmp, list, list) {
-		if (!acl->is_deleted)
+		if (acl->is_deleted != true)
 			continue;
 		acl->is_deleted = CCS_GC_IN_PROGRESS;
-		ccs_try_to_gc(CCS_ID_ACL, &acl->list);
+		ccs_try_to_gc(CCS_ID_ACL, &acl->list, list);
 	}
 }
 
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+
+/**
+ * ccs_has_auto_transition - Check for "task auto_domain_transition" entries.
+ *
+ * @list: Pointer to "struct list_head" of "struct ccs_acl_info".
+ *
+ * Returns true if @list has an entry which is not deleted, false otherwise.
+ *
+ * Entries in uncommitted transactions are counted as well.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static bool ccs_has_auto_transition(const struct list_head *list)
+{
+	struct ccs_acl_info *ptr;
+	list_for_each_entry(ptr, list, list) {
+		if (ptr->type == CCS_TYPE_AUTO_TASK_ACL &&
+		    ptr->is_deleted != true &&
+		    ptr->is_deleted != CCS_GC_IN_PROGRESS)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * ccs_recheck_auto_transition - Recompute ccs_auto_transition_used.
+ *
+ * Returns nothing.
+ *
+ * Called after deleted ACL entries were collected, so that checks which skip
+ * ccs_init_request_info() are enabled again once the last
+ * "task auto_domain_transition" entry is gone.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_recheck_auto_transition(void)
+{
+	struct ccs_policy_namespace *ns;
+	struct ccs_domain_info *domain;
+	int i;
+	if (!ccs_auto_transition_used)
+		return;
+	list_for_each_entry(domain, &ccs_domain_list, list)
+		if (ccs_has_auto_transition(&domain->acl_info_list))
+			return;
+	list_for_each_entry(ns, &ccs_namespace_list, namespace_list)
+		for (i = 0; i < CCS_MAX_ACL_GROUPS; i++)
+			if (ccs_has_auto_transition(&ns->acl_group[i]))
+				return;
+	ccs_auto_transition_used = false;
+}
+
+#endif
+
 /**
  * ccs_collect_entry - Try to kfree() deleted elements.
  *
@@ -882,138 +1219,713 @@ static void ccs_collect_entry(void)
 	int i;
 	enum ccs_policy_id id;
 	struct ccs_policy_namespace *ns;
+	bool rescan;
+	bool acl;
 	mutex_lock(&ccs_policy_lock);
-	{
+	rescan = test_and_clear_bit(CCS_GC_DIRTY_RESCAN, &ccs_gc_dirty);
+	/*
+	 * Elements are collected in stages with ccs_flush_gc() in between, for
+	 * elements collected in a stage drop references on elements collected
+	 * in subsequent stages, and containers must not be collected while
+	 * their members might be reinjected.
+	 *
+	 * Each stage visits only lists which were marked by ccs_mark_garbage()
+	 * or ccs_put_*() since previous run, unless previous run had to
+	 * reinject elements.
+	 */
+	acl = test_and_clear_bit(CCS_GC_DIRTY_ACL, &ccs_gc_dirty) || rescan;
+	if (acl) {
+		struct ccs_domain_info *domain;
+		list_for_each_entry(domain, &ccs_domain_list, list) {
+			if (!domain->gc_pending && !rescan)
+				continue;
+			domain->gc_pending = false;
+			ccs_collect_acl(&domain->acl_info_list);
+		}
+		list_for_each_entry(ns, &ccs_namespace_list, namespace_list)
+			for (i = 0; i < CCS_MAX_ACL_GROUPS; i++)
+				if (__test_and_clear_bit(i, ns->acl_group_dirty)
+				    || rescan)
+					ccs_collect_acl(&ns->acl_group[i]);
+	}
+	if (test_and_clear_bit(CCS_GC_DIRTY_POLICY, &ccs_gc_dirty) || rescan) {
+		list_for_each_entry(ns, &ccs_namespace_list, namespace_list) {
+			for (id = 0; id < CCS_MAX_POLICY; id++)
+				if (__test_and_clear_bit(id, ns->policy_dirty) ||
+				    rescan)
+					ccs_collect_member(id,
+							   &ns->policy_list[id]);
+			for (i = 0; i < CCS_MAX_GROUP; i++) {
+				struct ccs_group *group;
+				switch (i) {
+				case 0:
+					id = CCS_ID_PATH_GROUP;
+					break;
+				case 1:
+					id = CCS_ID_NUMBER_GROUP;
+					break;
+				default:
+#ifdef CONFIG_CCSECURITY_NETWORK
+					id = CCS_ID_ADDRESS_GROUP;
+#else
+					continue;
+#endif
+					break;
+				}
+				list_for_each_entry(group, &ns->group_list[i],
+						    head.list) {
+					if (!group->gc_pending && !rescan)
+						continue;
+					group->gc_pending = false;
+					ccs_collect_member(id,
+							   &group->member_list);
+					/* This group might have become empty. */
+					set_bit(CCS_GC_DIRTY_GROUP,
+						&ccs_gc_dirty);
+				}
+			}
+		}
+	}
+	ccs_flush_gc();
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+	if (acl)
+		ccs_recheck_auto_transition();
+#endif
+	if (test_and_clear_bit(CCS_GC_DIRTY_DOMAIN, &ccs_gc_dirty) || rescan) {
 		struct ccs_domain_info *domain;
 		struct ccs_domain_info *tmp;
 		list_for_each_entry_safe(domain, tmp, &ccs_domain_list, list) {
-			ccs_collect_acl(&domain->acl_info_list);
-			if (!domain->is_deleted ||
-			    ccs_domain_used_by_task(domain))
+			if (!domain->is_deleted)
 				continue;
-			ccs_try_to_gc(CCS_ID_DOMAIN, &domain->list);
+			if (ccs_domain_used_by_task(domain)) {
+				/* Retry upon next run. */
+				set_bit(CCS_GC_DIRTY_DOMAIN, &ccs_gc_dirty);
+				continue;
+			}
+			ccs_try_to_gc(CCS_ID_DOMAIN, &domain->list, NULL);
 		}
 	}
-	list_for_each_entry(ns, &ccs_namespace_list, namespace_list) {
-		for (id = 0; id < CCS_MAX_POLICY; id++)
-			ccs_collect_member(id, &ns->policy_list[id]);
+	ccs_flush_gc();
+	if (test_and_clear_bit(CCS_GC_DIRTY_CONDITION, &ccs_gc_dirty) ||
+	    rescan) {
+		for (i = 0; i < CCS_MAX_CONDITION_HASH; i++) {
+			struct list_head *list = &ccs_condition_list[i];
+			struct ccs_shared_acl_head *ptr;
+			struct ccs_shared_acl_head *tmp;
+			list_for_each_entry_safe(ptr, tmp, list, list) {
+				if (atomic_read(&ptr->users) > 0)
+					continue;
+				atomic_set(&ptr->users, CCS_GC_IN_PROGRESS);
+				ccs_try_to_gc(CCS_ID_CONDITION, &ptr->list,
+					      NULL);
+			}
+		}
+	}
+	ccs_flush_gc();
+	if (test_and_clear_bit(CCS_GC_DIRTY_GROUP, &ccs_gc_dirty) || rescan) {
+		list_for_each_entry(ns, &ccs_namespace_list, namespace_list) {
+			for (i = 0; i < CCS_MAX_GROUP; i++) {
+				struct list_head *list = &ns->group_list[i];
+				struct ccs_group *group;
+				struct ccs_group *tmp;
+				list_for_each_entry_safe(group, tmp, list,
+							 head.list) {
+					if (!list_empty(&group->member_list) ||
+					    atomic_read(&group->head.users) > 0)
+						continue;
+					atomic_set(&group->head.users,
+						   CCS_GC_IN_PROGRESS);
+					ccs_try_to_gc(CCS_ID_GROUP,
+						      &group->head.list, NULL);
+				}
+			}
+		}
+	}
+	ccs_flush_gc();
+	if (test_and_clear_bit(CCS_GC_DIRTY_NAME, &ccs_gc_dirty) || rescan) {
+		for (i = 0; i < CCS_MAX_HASH; i++) {
+			struct list_head *list = &ccs_name_list[i];
+			struct ccs_shared_acl_head *ptr;
+			struct ccs_shared_acl_head *tmp;
+			list_for_each_entry_safe(ptr, tmp, list, list) {
+				if (atomic_read(&ptr->users) > 0)
+					continue;
+				atomic_set(&ptr->users, CCS_GC_IN_PROGRESS);
+				ccs_try_to_gc(CCS_ID_NAME, &ptr->list, NULL);
+			}
+		}
+	}
+	ccs_flush_gc();
+	mutex_unlock(&ccs_policy_lock);
+}
+
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+
+/**
+ * ccs_build_hot_acl - Build "struct ccs_hot_acl" for a domain.
+ *
+ * @domain: Pointer to "struct ccs_domain_info".
+ *
+ * Returns pointer to "struct ccs_hot_acl" on success, NULL otherwise.
+ *
+ * Checking entries out of list order is safe only if every matching entry
+ * merely grants the request. If an entry in the domain or its ACL groups has
+ * an "auto_domain_transition=" or "grant_log=" condition, the first match
+ * decides more than that, and the returned array is empty. Execute handler
+ * entries are never ordered, for the first match selects the handler.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static struct ccs_hot_acl *ccs_build_hot_acl
+(const struct ccs_domain_info *domain)
+{
+	const struct list_head *list = &domain->acl_info_list;
+	struct ccs_hot_acl *hot = kzalloc(sizeof(*hot), CCS_GFP_FLAGS);
+	u32 hits[CCS_HOT_ACL_MAX];
+	struct ccs_acl_info *ptr;
+	u16 i = 0;
+	if (!hot)
+		return NULL;
+	hot->generation = ccs_acl_generation;
+retry:
+	list_for_each_entry(ptr, list, list) {
+		const struct ccs_condition *cond = ptr->cond;
+		const u32 count = ccs_sum_hits(ptr);
+		unsigned int j;
+		if (ccs_deleted(ptr->is_deleted))
+			continue;
+		if (cond && (cond->transit ||
+			     cond->grant_log != CCS_GRANTLOG_AUTO)) {
+			hot->count = 0;
+			return hot;
+		}
+#ifdef CONFIG_CCSECURITY_TASK_EXECUTE_HANDLER
+		if (ptr->type == CCS_TYPE_AUTO_EXECUTE_HANDLER ||
+		    ptr->type == CCS_TYPE_DENIED_EXECUTE_HANDLER)
+			continue;
+#endif
+		if (!count)
+			continue;
+		for (j = hot->count; j && hits[j - 1] < count; j--)
+			;
+		if (j == CCS_HOT_ACL_MAX)
+			continue;
+		if (hot->count < CCS_HOT_ACL_MAX)
+			hot->count++;
+		memmove(&hot->acl[j + 1], &hot->acl[j],
+			(hot->count - 1 - j) * sizeof(hot->acl[0]));
+		memmove(&hits[j + 1], &hits[j],
+			(hot->count - 1 - j) * sizeof(hits[0]));
+		hot->acl[j] = ptr;
+		hits[j] = count;
+	}
+	for (; i < CCS_MAX_ACL_GROUPS; i++) {
+		if (!test_bit(i, domain->group))
+			continue;
+		list = &domain->ns->acl_group[i++];
+		goto retry;
+	}
+	return hot;
+}
+
+/**
+ * ccs_decay_hits - Halve hit counts of ACL entries.
+ *
+ * @list: Pointer to "struct list_head".
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_decay_hits(struct list_head *list)
+{
+	struct ccs_acl_info *ptr;
+	int cpu;
+	list_for_each_entry(ptr, list, list) {
+		if (!ptr->hits)
+			continue;
+		for_each_possible_cpu(cpu)
+			*per_cpu_ptr(ptr->hits, cpu) /= 2;
+	}
+}
+
+/**
+ * ccs_sum_hits - Sum up per-CPU hit counts of an ACL entry.
+ *
+ * @ptr: Pointer to "struct ccs_acl_info".
+ *
+ * Returns sampled number of requests granted by @ptr.
+ *
+ * Counters are read without locks, for the result is only a hint.
+ */
+static u32 ccs_sum_hits(const struct ccs_acl_info *ptr)
+{
+	u32 count = 0;
+	int cpu;
+	if (!ptr->hits)
+		return 0;
+	for_each_possible_cpu(cpu)
+		count += *per_cpu_ptr(ptr->hits, cpu);
+	return count;
+}
+
+/**
+ * ccs_reorder_acl - Republish frequently matched ACL entries of busy domains.
+ *
+ * Returns nothing.
+ *
+ * ccs_check_acl() tries "struct ccs_domain_info"->hot_acl before walking the
+ * lists, which are left in the order /proc/ccs/domain_policy prints them.
+ * Only domains which ccs_count_hit() marked as "hot_pending" are rebuilt, for
+ * other domains have no new samples to reorder by. Hit counts of rebuilt
+ * domains and of ACL groups are halved after each run so that the order
+ * follows recent requests.
+ */
+static void ccs_reorder_acl(void)
+{
+	struct ccs_hot_acl *stale = NULL;
+	struct ccs_policy_namespace *ns;
+	struct ccs_domain_info *domain;
+	int i;
+	mutex_lock(&ccs_policy_lock);
+	list_for_each_entry(domain, &ccs_domain_list, list) {
+		struct ccs_hot_acl *hot;
+		if (!domain->hot_pending || domain->is_deleted)
+			continue;
+		domain->hot_pending = false;
+		hot = ccs_build_hot_acl(domain);
+		ccs_decay_hits(&domain->acl_info_list);
+		if (!hot)
+			continue;
+		if (!hot->count && !domain->hot_acl) {
+			kfree(hot);
+			continue;
+		}
+		if (domain->hot_acl) {
+			domain->hot_acl->stale = stale;
+			stale = domain->hot_acl;
+		}
+		rcu_assign_pointer(domain->hot_acl, hot);
+	}
+	list_for_each_entry(ns, &ccs_namespace_list, namespace_list)
+		for (i = 0; i < CCS_MAX_ACL_GROUPS; i++)
+			ccs_decay_hits(&ns->acl_group[i]);
+	mutex_unlock(&ccs_policy_lock);
+	if (!stale)
+		return;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 19)
+	synchronize_srcu(&ccs_ss);
+#else
+	ccs_synchronize_counter();
+#endif
+	while (stale) {
+		struct ccs_hot_acl *next = stale->stale;
+		kfree(stale);
+		stale = next;
+	}
+}
+
+#endif
+
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+
+/**
+ * ccs_collect_acl_table - Count or store ACL entries of a list by type.
+ *
+ * @list:  Pointer to "struct list_head".
+ * @count: Array of CCS_MAX_ACL_TYPE counters, incremented per entry.
+ * @table: Pointer to "struct ccs_acl_table" to store entries. Maybe NULL.
+ *
+ * Returns nothing.
+ *
+ * Entries staged by a transaction are stored, for ccs_match_acl() checks
+ * ccs_deleted() of each entry anyway.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_collect_acl_table(const struct list_head *list, u32 *count,
+				  struct ccs_acl_table *table)
+{
+	struct ccs_acl_info *ptr;
+	list_for_each_entry(ptr, list, list) {
+		if (ptr->is_deleted == true)
+			continue;
+		if (table)
+			table->acl[table->start[ptr->type] + count[ptr->type]] =
+				ptr;
+		count[ptr->type]++;
+	}
+}
+
+/**
+ * ccs_build_acl_table - Build "struct ccs_acl_table" for an ACL list.
+ *
+ * @list:       Pointer to "struct list_head".
+ * @generation: Current "acl_generation" of @list.
+ *
+ * Returns pointer to "struct ccs_acl_table" on success, NULL otherwise.
+ *
+ * The table is aligned to a cache line so that the header and the first
+ * entries share one line, and is charged to the policy memory quota.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static struct ccs_acl_table *ccs_build_acl_table(const struct list_head *list,
+						 const unsigned int generation)
+{
+	u32 count[CCS_MAX_ACL_TYPE] = { };
+	struct ccs_acl_table *table;
+	unsigned int size;
+	u32 total = 0;
+	void *raw;
+	u8 i;
+	ccs_collect_acl_table(list, count, NULL);
+	for (i = 0; i < CCS_MAX_ACL_TYPE; i++)
+		total += count[i];
+	size = ccs_round2(sizeof(*table) + total * sizeof(table->acl[0]) +
+			  L1_CACHE_BYTES - 1);
+	if (ccs_memory_quota[CCS_MEMORY_POLICY] &&
+	    ccs_memory_used[CCS_MEMORY_POLICY] + size >
+	    ccs_memory_quota[CCS_MEMORY_POLICY])
+		return NULL;
+	raw = kzalloc(size, CCS_GFP_FLAGS | __GFP_NOWARN);
+	if (!raw)
+		return NULL;
+	ccs_memory_used[CCS_MEMORY_POLICY] += size;
+	table = (struct ccs_acl_table *) L1_CACHE_ALIGN((unsigned long) raw);
+	table->raw = raw;
+	table->size = size;
+	table->generation = generation;
+	for (i = 0; i < CCS_MAX_ACL_TYPE; i++) {
+		table->start[i + 1] = table->start[i] + count[i];
+		count[i] = 0;
+	}
+	ccs_collect_acl_table(list, count, table);
+	return table;
+}
+
+/**
+ * ccs_free_acl_table - Release "struct ccs_acl_table".
+ *
+ * @table: Pointer to "struct ccs_acl_table". Maybe NULL.
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex, or @table was uncharged by
+ * ccs_compile_list().
+ */
+static void ccs_free_acl_table(struct ccs_acl_table *table)
+{
+	if (table)
+		kfree(table->raw);
+}
+
+/**
+ * ccs_compile_list - Republish "struct ccs_acl_table" of an ACL list if stale.
+ *
+ * @list:       Pointer to "struct list_head".
+ * @tablep:     Pointer to "struct ccs_acl_table *" of @list.
+ * @generation: Current "acl_generation" of @list.
+ * @stale:      Pointer to list of replaced tables to free.
+ *
+ * Returns nothing.
+ *
+ * A replaced table is uncharged here, for it is freed after an SRCU grace
+ * period without ccs_policy_lock held.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_compile_list(const struct list_head *list,
+			     struct ccs_acl_table **tablep,
+			     const unsigned int generation,
+			     struct ccs_acl_table **stale)
+{
+	struct ccs_acl_table *table = *tablep;
+	if (table ? table->generation == generation : list_empty(list))
+		return;
+	if (list_empty(list)) {
+		table = NULL;
+	} else {
+		table = ccs_build_acl_table(list, generation);
+		if (!table)
+			return;
+	}
+	if (*tablep) {
+		ccs_memory_used[CCS_MEMORY_POLICY] -= (*tablep)->size;
+		(*tablep)->stale = *stale;
+		*stale = *tablep;
+	}
+	rcu_assign_pointer(*tablep, table);
+}
+
+/**
+ * ccs_compile_acl - Republish stale "struct ccs_acl_table" of ACL lists.
+ *
+ * Returns nothing.
+ *
+ * ccs_check_acl() visits only entries of the requested type in a table
+ * instead of chasing every list element of the domain and its ACL groups.
+ * The lists stay the source of truth for /proc/ccs/ interfaces and the
+ * garbage collector. Each list has its own generation counter, and only
+ * tables of lists modified since they were built are rebuilt.
+ */
+static void ccs_compile_acl(void)
+{
+	struct ccs_acl_table *stale = NULL;
+	struct ccs_policy_namespace *ns;
+	struct ccs_domain_info *domain;
+	unsigned int i;
+	mutex_lock(&ccs_policy_lock);
+	list_for_each_entry(domain, &ccs_domain_list, list) {
+		if (domain->is_deleted)
+			continue;
+		ccs_compile_list(&domain->acl_info_list, &domain->acl_table,
+				 domain->acl_generation, &stale);
+	}
+	list_for_each_entry(ns, &ccs_namespace_list, namespace_list)
 		for (i = 0; i < CCS_MAX_ACL_GROUPS; i++)
-			ccs_collect_acl(&ns->acl_group[i]);
+			ccs_compile_list(&ns->acl_group[i],
+					 &ns->acl_group_table[i],
+					 ns->acl_group_generation[i], &stale);
+	mutex_unlock(&ccs_policy_lock);
+	if (!stale)
+		return;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 19)
+	synchronize_srcu(&ccs_ss);
+#else
+	ccs_synchronize_counter();
+#endif
+	while (stale) {
+		struct ccs_acl_table *next = stale->stale;
+		ccs_free_acl_table(stale);
+		stale = next;
 	}
-	{
-		struct ccs_shared_acl_head *ptr;
-		struct ccs_shared_acl_head *tmp;
-		list_for_each_entry_safe(ptr, tmp, &ccs_condition_list, list) {
-			if (atomic_read(&ptr->users) > 0)
+}
+
+/**
+ * ccs_touch_acl_list - Invalidate "struct ccs_acl_table" of an ACL list.
+ *
+ * @ns:   Pointer to "struct ccs_policy_namespace" which @list belongs to.
+ * @list: Pointer to "struct list_head" of "struct ccs_acl_info".
+ *
+ * Returns nothing.
+ *
+ * Tables of other lists remain valid.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+void ccs_touch_acl_list(struct ccs_policy_namespace *ns,
+			struct list_head *list)
+{
+	if (list >= ns->acl_group && list < ns->acl_group + CCS_MAX_ACL_GROUPS)
+		ns->acl_group_generation[list - ns->acl_group]++;
+	else
+		container_of(list, struct ccs_domain_info,
+			     acl_info_list)->acl_generation++;
+}
+
+#endif
+
+/**
+ * ccs_rebuild_index - Republish stale "struct ccs_domain_index" of domains.
+ *
+ * Returns nothing.
+ *
+ * Only indexes which ccs_get_domain_index() found stale are rebuilt, for
+ * most domains never make requests which an index can answer.
+ */
+static void ccs_rebuild_index(void)
+{
+	struct ccs_domain_index *stale = NULL;
+	struct ccs_domain_info *domain;
+	u8 i;
+	mutex_lock(&ccs_policy_lock);
+	list_for_each_entry(domain, &ccs_domain_list, list) {
+		if (domain->is_deleted || !domain->index_pending)
+			continue;
+		for (i = 0; i < CCS_MAX_DOMAIN_INDEX; i++) {
+			struct ccs_domain_index *index = domain->index[i];
+			if (!test_and_clear_bit(i, &domain->index_pending) ||
+			    (index && index->generation == ccs_acl_generation))
 				continue;
-			atomic_set(&ptr->users, CCS_GC_IN_PROGRESS);
-			ccs_try_to_gc(CCS_ID_CONDITION, &ptr->list);
+			index = ccs_build_domain_index(domain, i);
+			if (!index)
+				continue;
+			if (domain->index[i]) {
+				ccs_memory_used[CCS_MEMORY_POLICY] -=
+					domain->index[i]->size;
+				domain->index[i]->stale = stale;
+				stale = domain->index[i];
+			}
+			rcu_assign_pointer(domain->index[i], index);
 		}
 	}
+	mutex_unlock(&ccs_policy_lock);
+	ccs_release_index(stale);
+}
+
+/**
+ * ccs_rebuild_ranges - Republish stale sorted members of groups.
+ *
+ * Returns nothing.
+ *
+ * Only groups which ccs_get_group_ranges() found stale are sorted, for most
+ * groups are never used by requests which sorted members can answer.
+ */
+static void ccs_rebuild_ranges(void)
+{
+	struct ccs_domain_index *stale = NULL;
+	struct ccs_policy_namespace *ns;
+	struct ccs_group *group;
+	u8 i;
+	mutex_lock(&ccs_policy_lock);
 	list_for_each_entry(ns, &ccs_namespace_list, namespace_list) {
 		for (i = 0; i < CCS_MAX_GROUP; i++) {
 			struct list_head *list = &ns->group_list[i];
-			struct ccs_group *group;
-			struct ccs_group *tmp;
-			switch (i) {
-			case 0:
-				id = CCS_ID_PATH_GROUP;
-				break;
-			case 1:
-				id = CCS_ID_NUMBER_GROUP;
-				break;
-			default:
-#ifdef CONFIG_CCSECURITY_NETWORK
-				id = CCS_ID_ADDRESS_GROUP;
-#else
-				continue;
-#endif
-				break;
-			}
-			list_for_each_entry_safe(group, tmp, list, head.list) {
-				ccs_collect_member(id, &group->member_list);
-				if (!list_empty(&group->member_list) ||
-				    atomic_read(&group->head.users) > 0)
+			list_for_each_entry(group, list, head.list) {
+				struct ccs_domain_index *ranges =
+					group->ranges;
+				if (!group->ranges_pending)
+					continue;
+				group->ranges_pending = false;
+				if (ranges &&
+				    ranges->generation == ccs_acl_generation)
+					continue;
+				ranges = ccs_build_group_ranges(group, i);
+				if (!ranges)
 					continue;
-				atomic_set(&group->head.users,
-					   CCS_GC_IN_PROGRESS);
-				ccs_try_to_gc(CCS_ID_GROUP, &group->head.list);
+				if (group->ranges) {
+					ccs_memory_used[CCS_MEMORY_POLICY] -=
+						group->ranges->size;
+					group->ranges->stale = stale;
+					stale = group->ranges;
+				}
+				rcu_assign_pointer(group->ranges, ranges);
 			}
 		}
 	}
-	for (i = 0; i < CCS_MAX_HASH; i++) {
-		struct list_head *list = &ccs_name_list[i];
-		struct ccs_shared_acl_head *ptr;
-		struct ccs_shared_acl_head *tmp;
-		list_for_each_entry_safe(ptr, tmp, list, list) {
-			if (atomic_read(&ptr->users) > 0)
-				continue;
-			atomic_set(&ptr->users, CCS_GC_IN_PROGRESS);
-			ccs_try_to_gc(CCS_ID_NAME, &ptr->list);
-		}
-	}
 	mutex_unlock(&ccs_policy_lock);
+	ccs_release_index(stale);
 }
 
 /**
- * ccs_gc_thread - Garbage collector thread function.
+ * ccs_release_index - Release stale indexes after an SRCU grace period.
  *
- * @unused: Unused.
+ * @stale: Pointer to "struct ccs_domain_index" chained by @stale member.
+ *         Maybe NULL.
  *
- * Returns 0.
+ * Returns nothing.
  */
-static int ccs_gc_thread(void *unused)
+static void ccs_release_index(struct ccs_domain_index *stale)
 {
-	/* Garbage collector thread is exclusive. */
-	static DEFINE_MUTEX(ccs_gc_mutex);
-	if (!mutex_trylock(&ccs_gc_mutex))
-		goto out;
-#if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 6)
-	/* daemonize() not needed. */
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2, 5, 0)
-	daemonize("GC for CCS");
+	if (!stale)
+		return;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 19)
+	synchronize_srcu(&ccs_ss);
 #else
-	daemonize();
-	reparent_to_init();
-#if defined(TASK_DEAD)
-	{
-		struct task_struct *task = current;
-		spin_lock_irq(&task->sighand->siglock);
-		siginitsetinv(&task->blocked, 0);
-		recalc_sigpending();
-		spin_unlock_irq(&task->sighand->siglock);
+	ccs_synchronize_counter();
+#endif
+	while (stale) {
+		struct ccs_domain_index *next = stale->stale;
+		kfree(stale);
+		stale = next;
 	}
+}
+
+/**
+ * ccs_run_gc - Garbage collector function.
+ *
+ * @unused: Unused.
+ *
+ * Returns nothing.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 20)
+static void ccs_run_gc(struct work_struct *unused)
 #else
-	{
-		struct task_struct *task = current;
-		spin_lock_irq(&task->sigmask_lock);
-		siginitsetinv(&task->blocked, 0);
-		recalc_sigpending(task);
-		spin_unlock_irq(&task->sigmask_lock);
+static void ccs_run_gc(void *unused)
+#endif
+{
+	/*
+	 * Garbage collector is exclusive. Old kernels may run the same work
+	 * on multiple CPUs if it was queued again while it was running.
+	 */
+	static DEFINE_MUTEX(ccs_gc_mutex);
+	mutex_lock(&ccs_gc_mutex);
+	if (test_and_clear_bit(CCS_GC_DIRTY_TXN, &ccs_gc_dirty)) {
+		u8 busy;
+		u8 i;
+		mutex_lock(&ccs_policy_lock);
+		busy = ccs_txn_busy;
+		mutex_unlock(&ccs_policy_lock);
+		/*
+		 * Readers which saw CCS_TXN_* states of ended transactions
+		 * must be gone before ccs_deleted() forgets the commit and
+		 * ccs_begin_txn() reuses the slot.
+		 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 19)
+		synchronize_srcu(&ccs_ss);
+#else
+		ccs_synchronize_counter();
+#endif
+		mutex_lock(&ccs_policy_lock);
+		for (i = 0; i < CCS_TXN_SLOTS; i++)
+			if (busy & (1 << i))
+				ccs_txn_committed[i] = false;
+		ccs_txn_busy &= ~busy;
+		mutex_unlock(&ccs_policy_lock);
 	}
+	if (test_and_clear_bit(CCS_GC_DIRTY_INDEX, &ccs_gc_dirty))
+		ccs_rebuild_index();
+	if (test_and_clear_bit(CCS_GC_DIRTY_RANGES, &ccs_gc_dirty))
+		ccs_rebuild_ranges();
+#ifdef CONFIG_CCSECURITY_NETWORK
+	if (test_and_clear_bit(CCS_GC_DIRTY_SOCKET, &ccs_gc_dirty))
+		ccs_grow_socket_cache();
+#endif
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+	if (test_and_clear_bit(CCS_GC_DIRTY_HOT, &ccs_gc_dirty))
+		ccs_reorder_acl();
 #endif
-	snprintf(current->comm, sizeof(current->comm) - 1, "GC for CCS");
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+	if (test_and_clear_bit(CCS_GC_DIRTY_TABLE, &ccs_gc_dirty))
+		ccs_compile_acl();
 #endif
 	ccs_collect_entry();
-	{
-		struct ccs_io_buffer *head;
-		struct ccs_io_buffer *tmp;
-		spin_lock(&ccs_io_buffer_list_lock);
-		list_for_each_entry_safe(head, tmp, &ccs_io_buffer_list,
-					 list) {
-			if (head->users)
-				continue;
-			list_del(&head->list);
-			kfree(head->read_buf);
-			kfree(head->write_buf);
-			kfree(head);
-		}
-		spin_unlock(&ccs_io_buffer_list_lock);
-	}
 	mutex_unlock(&ccs_gc_mutex);
-out:
-	/* This acts as do_exit(0). */
-	return 0;
+}
+
+/**
+ * ccs_mark_garbage - Remember a list which has deleted elements.
+ *
+ * @ns:     Pointer to "struct ccs_policy_namespace" which @list belongs to.
+ * @list:   Pointer to "struct list_head".
+ * @is_acl: True if @list is a list of "struct ccs_acl_info", false if @list
+ *          is a list of "struct ccs_acl_head".
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+void ccs_mark_garbage(struct ccs_policy_namespace *ns, struct list_head *list,
+		      const bool is_acl)
+{
+	if (is_acl) {
+		if (list >= ns->acl_group &&
+		    list < ns->acl_group + CCS_MAX_ACL_GROUPS)
+			__set_bit(list - ns->acl_group, ns->acl_group_dirty);
+		else
+			container_of(list, struct ccs_domain_info,
+				     acl_info_list)->gc_pending = true;
+		set_bit(CCS_GC_DIRTY_ACL, &ccs_gc_dirty);
+	} else {
+		if (list >= ns->policy_list &&
+		    list < ns->policy_list + CCS_MAX_POLICY)
+			__set_bit(list - ns->policy_list, ns->policy_dirty);
+		else
+			container_of(list, struct ccs_group,
+				     member_list)->gc_pending = true;
+		set_bit(CCS_GC_DIRTY_POLICY, &ccs_gc_dirty);
+	}
 }
 
 /**
@@ -1026,29 +1938,44 @@ out:
  */
 void ccs_notify_gc(struct ccs_io_buffer *head, const bool is_register)
 {
-	bool is_write = false;
-	spin_lock(&ccs_io_buffer_list_lock);
-	if (is_register) {
-		head->users = 1;
-		list_add(&head->list, &ccs_io_buffer_list);
-	} else {
-		is_write = head->write_buf != NULL;
-		if (!--head->users) {
-			list_del(&head->list);
-			kfree(head->read_buf);
-			kfree(head->write_buf);
-			kfree(head);
-		}
-	}
-	spin_unlock(&ccs_io_buffer_list_lock);
-	if (is_write) {
-#if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 6)
-		struct task_struct *task = kthread_create(ccs_gc_thread, NULL,
-							  "GC for CCS");
-		if (!IS_ERR(task))
-			wake_up_process(task);
-#else
-		kernel_thread(ccs_gc_thread, NULL, 0);
-#endif
-	}
+	u8 i;
+	if (is_register)
+		return;
+	spin_lock(&ccs_io_pin_lock);
+	for (i = 0; i < CCS_MAX_IO_PIN; i++)
+		if (head->pin[i].element)
+			list_del(&head->pin[i].list);
+	spin_unlock(&ccs_io_pin_lock);
+	kfree(head->w_copy);
+	kfree(head->read_buf);
+	kfree(head->write_buf);
+	kfree(head);
+	/*
+	 * Closing a reader might allow reinjected elements to be kfree()d,
+	 * and closing a writer might have deleted elements.
+	 */
+	if (ccs_gc_dirty)
+		schedule_work(&ccs_gc_work);
+}
+
+/**
+ * ccs_schedule_gc - Queue the garbage collector.
+ *
+ * Returns nothing.
+ */
+void ccs_schedule_gc(void)
+{
+	schedule_work(&ccs_gc_work);
+}
+
+/**
+ * ccs_gc_init - Initialize the garbage collector.
+ *
+ * Returns nothing.
+ */
+void __init ccs_gc_init(void)
+{
+	int idx;
+	for (idx = 0; idx < CCS_MAX_IO_PIN_HASH; idx++)
+		INIT_LIST_HEAD(&ccs_io_pin_list[idx]);
 }
@@ -49,6 +49,10 @@
 #include <linux/proc_fs.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0) || defined(RHEL_MAJOR)
 #include <linux/hash.h>
+#include <linux/jhash.h>
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 12)
+#include <linux/sort.h>
 #endif
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 18) || (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 33) && defined(CONFIG_SYSCTL_SYSCALL))
 #include <linux/sysctl.h>
@@ -56,6 +60,11 @@
 #if LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 6)
 #include <linux/kthread.h>
 #endif
+#include <linux/workqueue.h>
+#include <linux/rwsem.h>
+#include <linux/vmalloc.h>
+#include <linux/percpu.h>
+#include <linux/timex.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0)
 #include <linux/magic.h>
 #endif
@@ -90,6 +99,46 @@ struct path {
 
 #endif
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 12)
+
+/**
+ * sort - Sort an array of elements.
+ *
+ * @base: Pointer to the array.
+ * @num:  Number of elements in @base.
+ * @size: Size of each element in bytes.
+ * @cmp:  Pointer to comparison function.
+ * @swap: Unused.
+ *
+ * Returns nothing.
+ *
+ * This is a simple replacement of lib/sort.c which is not available in older
+ * kernels.
+ */
+static inline void sort(void *base, size_t num, size_t size,
+			int (*cmp) (const void *, const void *),
+			void (*swap) (void *, void *, int))
+{
+	char *array = base;
+	size_t i;
+	for (i = 1; i < num; i++) {
+		size_t j;
+		for (j = i; j && cmp(array + (j - 1) * size,
+				     array + j * size) > 0; j--) {
+			char *a = array + (j - 1) * size;
+			char *b = array + j * size;
+			size_t k;
+			for (k = 0; k < size; k++) {
+				const char c = a[k];
+				a[k] = b[k];
+				b[k] = c;
+			}
+		}
+	}
+}
+
+#endif
+
 #ifndef __printf
 #define __printf(a,b) __attribute__((format(printf,a,b)))
 #endif
@@ -110,6 +159,10 @@ struct path {
 #define __user
 #endif
 
+#ifndef __percpu
+#define __percpu
+#endif
+
 #ifndef current_uid
 #define current_uid()   (current->uid)
 #endif
@@ -481,6 +534,19 @@ static inline void __list_del_entry(struct list_head *entry)
 #ifndef CONFIG_CCSECURITY_ACTIVATION_TRIGGER
 #define CONFIG_CCSECURITY_ACTIVATION_TRIGGER "/sbin/init"
 #endif
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 3, 0)
+/* Latency histograms and tracepoints depend on static keys. */
+#undef CONFIG_CCSECURITY_LATENCY
+#undef CONFIG_CCSECURITY_TRACEPOINT
+#endif
+#ifdef CONFIG_CCSECURITY_LATENCY
+#include <linux/jump_label.h>
+#endif
+#if defined(CONFIG_CCSECURITY_LATENCY) || defined(CONFIG_CCSECURITY_TRACEPOINT)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#include <linux/sched/clock.h>
+#endif
+#endif
 #include "ccsecurity.h"
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 0)
 #error This module supports only 2.6.0 and later kernels.
@@ -528,6 +594,7 @@ enum ccs_acl_entry_type_index {
 	CCS_TYPE_AUTO_TASK_ACL,
 	CCS_TYPE_MANUAL_TASK_ACL,
 #endif
+	CCS_MAX_ACL_TYPE
 };
 
 /* Index numbers for "struct ccs_condition". */
@@ -635,6 +702,55 @@ enum ccs_group_id {
 	CCS_MAX_GROUP
 };
 
+/* Index numbers for kinds of elements the garbage collector has to visit. */
+enum ccs_gc_dirty_index {
+	CCS_GC_DIRTY_ACL,       /* Lists of "struct ccs_acl_info". */
+	CCS_GC_DIRTY_POLICY,    /* Lists of "struct ccs_acl_head". */
+	CCS_GC_DIRTY_DOMAIN,    /* ccs_domain_list . */
+	CCS_GC_DIRTY_CONDITION, /* ccs_condition_list[] . */
+	CCS_GC_DIRTY_GROUP,     /* "struct ccs_policy_namespace"->group_list . */
+	CCS_GC_DIRTY_NAME,      /* ccs_name_list . */
+	CCS_GC_DIRTY_RESCAN,    /* All of the above regardless of flags. */
+	CCS_GC_DIRTY_TXN,       /* ccs_txn_committed[] . */
+	CCS_GC_DIRTY_HOT,       /* "struct ccs_domain_info"->hot_acl . */
+	CCS_GC_DIRTY_TABLE,     /* "struct ccs_acl_table" of ACL lists. */
+	CCS_GC_DIRTY_INDEX,     /* "struct ccs_domain_info"->index[] . */
+	CCS_GC_DIRTY_RANGES,    /* "struct ccs_group"->ranges . */
+	CCS_GC_DIRTY_SOCKET     /* Hash table of "struct ccs_socket_cache". */
+};
+
+/* Index numbers for "struct ccs_domain_info"->index[] . */
+enum ccs_domain_index_type {
+#ifdef CONFIG_CCSECURITY_NETWORK
+	CCS_INDEX_INET, /* "struct ccs_inet_index" */
+#endif
+#ifdef CONFIG_CCSECURITY_MISC
+	CCS_INDEX_ENV,  /* "struct ccs_env_index" */
+#endif
+	CCS_MAX_DOMAIN_INDEX
+};
+
+/* Index numbers for LSM hooks which are enabled only when needed. */
+enum ccs_hook_group_index {
+#ifdef CONFIG_CCSECURITY_FILE_GETATTR
+	CCS_HOOK_FILE_GETATTR,
+#endif
+	CCS_HOOK_FILE_IOCTL,
+#ifdef CONFIG_CCSECURITY_NETWORK
+	CCS_HOOK_NETWORK,
+#endif
+	CCS_MAX_HOOK_GROUP
+};
+
+/* Index numbers for cursors in "struct ccs_io_buffer" which GC must obey. */
+enum ccs_io_pin_index {
+	CCS_PIN_READ_DOMAIN, /* "struct ccs_io_buffer"->r.domain */
+	CCS_PIN_READ_GROUP,  /* "struct ccs_io_buffer"->r.group  */
+	CCS_PIN_READ_ACL,    /* "struct ccs_io_buffer"->r.acl    */
+	CCS_PIN_WRITE_DOMAIN, /* "struct ccs_io_buffer"->w.domain */
+	CCS_MAX_IO_PIN
+};
+
 /* Index numbers for category of functionality. */
 enum ccs_mac_category_index {
 	CCS_MAC_CATEGORY_FILE,
@@ -735,6 +851,9 @@ enum ccs_memory_stat_type {
 	CCS_MEMORY_POLICY,
 	CCS_MEMORY_AUDIT,
 	CCS_MEMORY_QUERY,
+#ifdef CONFIG_CCSECURITY_NETWORK
+	CCS_MEMORY_SOCKET,
+#endif
 	CCS_MAX_MEMORY_STAT
 };
 
@@ -809,6 +928,16 @@ enum ccs_path_number_acl_index {
 	CCS_MAX_PATH_NUMBER_OPERATION
 };
 
+/* Index numbers for "struct ccs_condition_op". */
+enum ccs_condition_op_type {
+	CCS_COND_OP_FALSE,   /* Never matches.                         */
+	CCS_COND_OP_RANGE,   /* Compare @left with @values[].           */
+	CCS_COND_OP_BITOP,   /* Test @left against bitmask @values[0].  */
+	CCS_COND_OP_COMPARE, /* Compare @left with @right.              */
+	CCS_COND_OP_GROUP,   /* Compare @left with "struct ccs_group".  */
+	CCS_COND_OP_NAME,    /* Compare @left with "struct ccs_name_union". */
+};
+
 /* Index numbers for stat(). */
 enum ccs_path_stat_index {
 	/* Do not change this order. */
@@ -850,6 +979,20 @@ enum ccs_policy_stat_type {
 	CCS_MAX_POLICY_STAT
 };
 
+/* Index numbers for performance counters in /proc/ccs/stat interface. */
+enum ccs_perf_stat_type {
+	CCS_STAT_REALPATH,
+#ifdef CONFIG_CCSECURITY_NETWORK
+	CCS_STAT_SOCKET_CACHE_HIT,
+	CCS_STAT_SOCKET_CACHE_MISS,
+#endif
+	CCS_STAT_AUDIT_DROPPED,
+	CCS_STAT_QUERY_TIMEOUT,
+	CCS_STAT_GC_BATCHES,
+	CCS_STAT_GC_ELEMENTS,
+	CCS_MAX_PERF_STAT
+};
+
 /* Index numbers for profile's PREFERENCE values. */
 enum ccs_pref_index {
 	CCS_PREF_MAX_AUDIT_LOG,
@@ -872,6 +1015,53 @@ enum ccs_proc_interface_index {
 #ifdef CONFIG_CCSECURITY_TASK_EXECUTE_HANDLER
 	CCS_EXECUTE_HANDLER,
 #endif
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+	CCS_ACL_PROFILE,
+#endif
+#ifdef CONFIG_CCSECURITY_LATENCY
+	CCS_LATENCY,
+#endif
+};
+
+/* Index numbers for /proc/ccs/latency histograms. */
+enum ccs_latency_index {
+	/* LSM hooks. */
+	CCS_LATENCY_BPRM_CHECK,
+	CCS_LATENCY_FILE_OPEN,
+	CCS_LATENCY_FILE_FCNTL,
+	CCS_LATENCY_FILE_IOCTL,
+	CCS_LATENCY_INODE_GETATTR,
+	CCS_LATENCY_INODE_SETATTR,
+	CCS_LATENCY_CHOWN,
+	CCS_LATENCY_CHMOD,
+	CCS_LATENCY_CHROOT,
+	CCS_LATENCY_TRUNCATE,
+	CCS_LATENCY_MKNOD,
+	CCS_LATENCY_MKDIR,
+	CCS_LATENCY_RMDIR,
+	CCS_LATENCY_UNLINK,
+	CCS_LATENCY_SYMLINK,
+	CCS_LATENCY_RENAME,
+	CCS_LATENCY_LINK,
+	CCS_LATENCY_SB_MOUNT,
+	CCS_LATENCY_SB_UMOUNT,
+	CCS_LATENCY_SB_PIVOTROOT,
+	CCS_LATENCY_SOCKET_BIND,
+	CCS_LATENCY_SOCKET_CONNECT,
+	CCS_LATENCY_SOCKET_LISTEN,
+	CCS_LATENCY_SOCKET_ACCEPT,
+	CCS_LATENCY_SOCKET_SENDMSG,
+	CCS_LATENCY_SOCKET_RECVMSG,
+	CCS_LATENCY_SOCKET_GETSOCKNAME,
+	CCS_LATENCY_SOCKET_GETPEERNAME,
+	CCS_LATENCY_SOCKET_GETSOCKOPT,
+	CCS_LATENCY_SOCKET_SETSOCKOPT,
+	CCS_LATENCY_SOCKET_SHUTDOWN,
+	/* Phases inside the hooks above. */
+	CCS_LATENCY_REALPATH,
+	CCS_LATENCY_ACL,
+	CCS_LATENCY_AUDIT,
+	CCS_MAX_LATENCY
 };
 
 /* Index numbers for special mount operations. */
@@ -916,6 +1106,13 @@ enum ccs_value_type {
 #define CCS_HASH_BITS 8
 #define CCS_MAX_HASH (1u << CCS_HASH_BITS)
 
+/*
+ * Policies with many conditional lines can have tens of thousands of distinct
+ * "struct ccs_condition", and every conditional line searches them.
+ */
+#define CCS_CONDITION_HASH_BITS 10
+#define CCS_MAX_CONDITION_HASH (1u << CCS_CONDITION_HASH_BITS)
+
 /*
  * TOMOYO checks only SOCK_STREAM, SOCK_DGRAM, SOCK_RAW, SOCK_SEQPACKET.
  * Therefore, we don't need SOCK_MAX.
@@ -928,12 +1125,43 @@ enum ccs_value_type {
 /* Garbage collector is trying to kfree() this element. */
 #define CCS_GC_IN_PROGRESS -1
 
+/*
+ * Transactions take slots in turn, so that a transaction can begin before
+ * readers forget the commit of the previous transaction. The slot is
+ * encoded in is_deleted together with the state below. See ccs_deleted().
+ */
+#define CCS_TXN_SLOTS 8
+
+/*
+ * This element is added or deleted by the current transaction which is not
+ * yet committed. Valid only while holding ccs_policy_lock mutex.
+ */
+#define CCS_TXN_ADDED   (2 + 2 * ccs_txn_slot)
+#define CCS_TXN_DELETED (3 + 2 * ccs_txn_slot)
+
 /* Profile number is an integer between 0 and 255. */
 #define CCS_MAX_PROFILES 256
 
 /* Group number is an integer between 0 and 255. */
 #define CCS_MAX_ACL_GROUPS 256
 
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+/* Number of frequently matched ACL entries checked first per domain. */
+#define CCS_HOT_ACL_MAX 8
+/* One out of this many granted requests is counted. Power of 2. */
+#define CCS_HOT_ACL_SAMPLE 16
+/* Minimal interval between rebuilding "struct ccs_hot_acl". */
+#define CCS_HOT_ACL_INTERVAL (10 * HZ)
+#endif
+
+#ifdef CONFIG_CCSECURITY_LATENCY
+/*
+ * Number of slots per histogram. Slot N > 0 counts latencies in
+ * [2^N, 2^(N+1)) nanoseconds, and the last slot also counts longer ones.
+ */
+#define CCS_LATENCY_SLOTS 32
+#endif
+
 /* Current thread is doing open(O_RDONLY | O_TRUNC) ? */
 #define CCS_OPEN_FOR_READ_TRUNCATE        1
 /* Current thread is doing open(3) ? */
@@ -965,7 +1193,7 @@ enum ccs_value_type {
 /* Common header for holding ACL entries. */
 struct ccs_acl_head {
 	struct list_head list;
-	s8 is_deleted; /* true or false or CCS_GC_IN_PROGRESS */
+	s8 is_deleted; /* true or false or CCS_GC_IN_PROGRESS or CCS_TXN_* */
 } __packed;
 
 /* Common header for shared entries. */
@@ -974,13 +1202,43 @@ struct ccs_shared_acl_head {
 	atomic_t users;
 } __packed;
 
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+
+/* Structure for counters of one step of evaluating an ACL entry. */
+struct ccs_eval_counter {
+	u64 evaluated; /* Number of evaluations. */
+	u64 matched;   /* Number of evaluations which matched. */
+	u64 cycles;    /* get_cycles() spent for evaluations. */
+};
+
+/*
+ * Structure for per-CPU counters shown in /proc/ccs/acl_profile . The profiler
+ * is opt-in: uncomment CONFIG_CCSECURITY_ACL_PROFILE in config.h to build it,
+ * for every ACL entry then carries these counters.
+ */
+struct ccs_acl_counter {
+	struct ccs_eval_counter entry; /* ccs_check_entry() */
+	struct ccs_eval_counter cond;  /* ccs_condition() of this entry */
+	u64 indexed; /* Number of matches found by ccs_find_indexed_acl(). */
+};
+
+#endif
+
 /* Common header for individual entries. */
 struct ccs_acl_info {
 	struct list_head list;
 	struct ccs_condition *cond; /* Maybe NULL. */
-	s8 is_deleted; /* true or false or CCS_GC_IN_PROGRESS */
+	s8 is_deleted; /* true or false or CCS_GC_IN_PROGRESS or CCS_TXN_* */
 	u8 type; /* One of values in "enum ccs_acl_entry_type_index". */
 	u16 perm;
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+	/* Sampled number of requests granted by this entry. Maybe NULL. */
+	u32 __percpu *hits;
+#endif
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+	/* Counters for evaluating this entry. Maybe NULL. */
+	struct ccs_acl_counter __percpu *profile;
+#endif
 } __packed;
 
 /* Structure for holding a word. */
@@ -1015,6 +1273,15 @@ struct ccs_group {
 	 * "struct ccs_address_group".
 	 */
 	struct list_head member_list;
+	/* True if @member_list has deleted members. */
+	bool gc_pending;
+	/*
+	 * Sorted and merged copy of member_list for "struct ccs_number_group"
+	 * and "struct ccs_address_group". NULL until needed.
+	 */
+	struct ccs_domain_index *ranges;
+	/* True if ccs_get_group_ranges() found @ranges stale. */
+	bool ranges_pending;
 };
 
 /* Structure for "path_group" directive. */
@@ -1057,10 +1324,26 @@ struct ccs_page_dump {
 	char *data;           /* Contents of "page". Size is PAGE_SIZE. */
 };
 
+/*
+ * Structure for argv[] and envp[] of "struct linux_binprm" copied by
+ * ccs_load_bprm().
+ */
+struct ccs_bprm_strings {
+	/*
+	 * bprm->argc + bprm->envc strings, each terminated by '\0'.
+	 * Allocated by vmalloc(). NULL if not yet copied.
+	 */
+	char *data;
+	size_t len; /* Length of @data in bytes. */
+};
+
 /* Structure for attribute checks in addition to pathname checks. */
 struct ccs_obj_info {
-	/* True if ccs_get_attributes() was already called, false otherwise. */
-	bool validate_done;
+	/*
+	 * Bitmask of "enum ccs_path_stat_index" which ccs_get_attributes()
+	 * already fetched.
+	 */
+	u8 stat_fetched;
 	/* True if @stat[] is valid. */
 	bool stat_valid[CCS_MAX_PATH_STAT];
 	/* First pathname. Initialized with { NULL, NULL } if no path. */
@@ -1097,6 +1380,26 @@ struct ccs_condition_element {
 	bool equals;
 };
 
+/*
+ * Structure for one step of "struct ccs_condition" compiled by
+ * ccs_compile_condition().
+ */
+struct ccs_condition_op {
+	u8 type; /* One of values in "enum ccs_condition_op_type". */
+	/*
+	 * Left hand operand. One of values in "enum ccs_conditions_index".
+	 * CCS_NUMBER_UNION if @values[] holds the operand for
+	 * CCS_COND_OP_GROUP.
+	 */
+	u8 left;
+	u8 right; /* Right hand operand for CCS_COND_OP_COMPARE. */
+	/* Equation operator. True if equals or overlaps, false otherwise. */
+	bool equals;
+	unsigned long values[2]; /* Constant operand folded at compile time. */
+	/* "struct ccs_group" or "struct ccs_name_union". Maybe NULL. */
+	const void *ptr;
+};
+
 /* Structure for optional arguments. */
 struct ccs_condition {
 	struct ccs_shared_acl_head head;
@@ -1108,7 +1411,12 @@ struct ccs_condition {
 	u16 envc; /* Number of "struct ccs_envp". */
 	u8 grant_log; /* One of values in "enum ccs_grant_log". */
 	bool exec_transit; /* True if transit is for "file execute". */
+	/* Bitmask of "enum ccs_path_stat_index" referenced by this struct. */
+	u8 stat_mask;
+	u16 opc; /* Number of "struct ccs_condition_op" in @ops. */
 	const struct ccs_path_info *transit; /* Maybe NULL. */
+	/* Compiled form of the conditions except argv[] and envp[]. */
+	const struct ccs_condition_op *ops;
 	/*
 	 * struct ccs_condition_element condition[condc];
 	 * struct ccs_number_union values[numbers_count];
@@ -1118,6 +1426,92 @@ struct ccs_condition {
 	 */
 };
 
+/*
+ * Structure for per-CPU counters shown in /proc/ccs/stat . Each CPU updates
+ * only its own copy and ccs_read_stat() sums them up.
+ */
+struct ccs_stat_counter {
+	/* Counter for number of updates. */
+	unsigned int updated[CCS_MAX_POLICY_STAT];
+	/* Timestamp counter for last updated. */
+	unsigned int modified[CCS_MAX_POLICY_STAT];
+	/* Indexed by "enum ccs_perf_stat_type". */
+	unsigned long perf[CCS_MAX_PERF_STAT];
+	/* Number of ccs_check_acl() calls, indexed by "enum ccs_mac_index". */
+	unsigned long acl_check[CCS_MAX_MAC_INDEX];
+};
+
+#ifdef CONFIG_CCSECURITY_LATENCY
+
+/* Structure for per-CPU log2 histograms shown in /proc/ccs/latency . */
+struct ccs_latency_histogram {
+	u64 count[CCS_MAX_LATENCY][CCS_LATENCY_SLOTS];
+};
+
+#endif
+
+/*
+ * Common header for lookup indexes of ACL entries of a domain and its ACL
+ * groups and for sorted members of a group, built by the garbage collector
+ * upon request from ccs_get_domain_index() and ccs_get_group_ranges().
+ */
+struct ccs_domain_index {
+	/* Value of ccs_acl_generation when this index was built. */
+	unsigned int generation;
+	/* Memory counted in ccs_memory_used[CCS_MEMORY_POLICY]. */
+	unsigned int size;
+	/* Next index waiting for SRCU grace period. Used by GC. */
+	struct ccs_domain_index *stale;
+};
+
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+
+/* Structure for ACL entries of a domain ordered by sampled hit count. */
+struct ccs_hot_acl {
+	/* Value of ccs_acl_generation when this array was built. */
+	unsigned int generation;
+	unsigned int count; /* Number of valid elements in @acl[]. */
+	struct ccs_acl_info *acl[CCS_HOT_ACL_MAX];
+	/* Next array waiting for SRCU grace period. Used by GC. */
+	struct ccs_hot_acl *stale;
+};
+
+#endif
+
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+
+/*
+ * Structure for ACL entries of one ACL list (a domain's acl_info_list or an
+ * ACL group), compiled by the garbage collector into one array sorted by
+ * type. Entries of each type are kept in list order. A table of an ACL group
+ * is shared by all domains which use that group. Starts at a cache line.
+ */
+struct ccs_acl_table {
+	/* "acl_generation" of the list when this table was built. */
+	unsigned int generation;
+	/* Memory counted in ccs_memory_used[CCS_MEMORY_POLICY]. */
+	unsigned int size;
+	/* Pointer returned by kzalloc(), for this table is aligned. */
+	void *raw;
+	/* Next table waiting for SRCU grace period. Used by GC. */
+	struct ccs_acl_table *stale;
+	/* Entries of type i are @acl[@start[i]] to @acl[@start[i + 1] - 1]. */
+	u32 start[CCS_MAX_ACL_TYPE + 1];
+	struct ccs_acl_info *acl[0];
+};
+
+#endif
+
+/* Structure for operands fetched while ccs_condition() runs. */
+struct ccs_condition_var {
+	struct ccs_obj_info *obj; /* Maybe NULL. */
+	struct linux_binprm *bprm; /* Maybe NULL. */
+	u8 stat_mask; /* "struct ccs_condition"->stat_mask */
+	bool cred_loaded; /* True if @cred[] is valid. */
+	/* Values of CCS_TASK_UID to CCS_TASK_FSGID. */
+	unsigned long cred[CCS_TASK_PID];
+};
+
 struct ccs_execve;
 struct ccs_policy_namespace;
 
@@ -1278,8 +1672,8 @@ struct ccs_execve {
 	/* For execute_handler */
 	const struct ccs_path_info *handler;
 	char *handler_path; /* = kstrdup(handler->name, CCS_GFP_FLAGS) */
-	/* For dumping argv[] and envp[]. */
-	struct ccs_page_dump dump;
+	/* argv[] and envp[] shared by conditions, environ and audit. */
+	struct ccs_bprm_strings strings;
 	/* For temporary use. */
 	char *tmp; /* Size is CCS_EXEC_TMPSIZE bytes */
 };
@@ -1296,7 +1690,35 @@ struct ccs_domain_info {
 	unsigned long group[CCS_MAX_ACL_GROUPS / BITS_PER_LONG];
 	u8 profile;        /* Profile number to use. */
 	bool is_deleted;   /* Delete flag.           */
+	bool gc_pending;   /* Has deleted ACL entries. */
 	bool flags[CCS_MAX_DOMAIN_INFO_FLAGS];
+	/*
+	 * Number of "struct ccs_security" and "struct ccs_execve" referring
+	 * this domain. Not maintained for ccs_kernel_domain which is never
+	 * deleted.
+	 */
+	atomic_t users;
+	/*
+	 * Number which is not reused by domains created later, unlike address
+	 * of this structure. 0 for ccs_kernel_domain.
+	 */
+	unsigned int serial;
+	/* Indexes of entries without conditions. Elements maybe NULL. */
+	struct ccs_domain_index *index[CCS_MAX_DOMAIN_INDEX];
+	/* Bitmap of @index[] which ccs_get_domain_index() found stale. */
+	unsigned long index_pending;
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+	/* Frequently matched entries checked before the lists. Maybe NULL. */
+	struct ccs_hot_acl *hot_acl;
+	/* True if requests were sampled since @hot_acl was built. */
+	bool hot_pending;
+#endif
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+	/* Entries checked instead of @acl_info_list. Maybe NULL. */
+	struct ccs_acl_table *acl_table;
+	/* Incremented whenever @acl_info_list is modified. */
+	unsigned int acl_generation;
+#endif
 };
 
 /*
@@ -1473,6 +1895,7 @@ struct ccs_acl_param {
 	struct list_head *list; /* List to add or remove. */
 	struct ccs_policy_namespace *ns; /* Namespace to use. */
 	bool is_delete; /* True if it is a delete request. */
+	bool txn; /* True if it is a part of a transaction. */
 	union ccs_acl_union {
 		struct ccs_acl_info acl_info;
 		struct ccs_handler_acl handler_acl;
@@ -1499,6 +1922,15 @@ struct ccs_acl_param {
 	} e;
 };
 
+/*
+ * Structure for telling GC not to kfree() a list element which a cursor of
+ * "struct ccs_io_buffer" is parked on.
+ */
+struct ccs_io_pin {
+	struct list_head list; /* Protected by ccs_io_pin_lock. */
+	const struct list_head *element; /* NULL if not pinned. */
+};
+
 /* Structure for reading/writing policy via /proc/ccs/ interfaces. */
 struct ccs_io_buffer {
 	/* Exclusive lock for this structure.   */
@@ -1539,12 +1971,14 @@ struct ccs_io_buffer {
 	char *write_buf;
 	/* Size of write buffer.                */
 	size_t writebuf_size;
+	/* Copy of words in r.w[] which were not yet copied to userspace. */
+	char *w_copy;
+	/* Size of w_copy.                      */
+	size_t w_copy_size;
 	/* Type of interface. */
 	enum ccs_proc_interface_index type;
-	/* Users counter protected by ccs_io_buffer_list_lock. */
-	u8 users;
-	/* List for telling GC not to kfree() elements. */
-	struct list_head list;
+	/* Cursors for telling GC not to kfree() elements. */
+	struct ccs_io_pin pin[CCS_MAX_IO_PIN];
 };
 
 /* Structure for /proc/ccs/profile interface. */
@@ -1575,6 +2009,16 @@ struct ccs_policy_namespace {
 	struct list_head policy_list[CCS_MAX_POLICY];
 	/* The global ACL referred by "use_group" keyword. */
 	struct list_head acl_group[CCS_MAX_ACL_GROUPS];
+	/* Bitmap of policy_list[] which have deleted elements. */
+	unsigned long policy_dirty[BITS_TO_LONGS(CCS_MAX_POLICY)];
+	/* Bitmap of acl_group[] which have deleted elements. */
+	unsigned long acl_group_dirty[CCS_MAX_ACL_GROUPS / BITS_PER_LONG];
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+	/* Entries checked instead of acl_group[]. Maybe NULL. */
+	struct ccs_acl_table *acl_group_table[CCS_MAX_ACL_GROUPS];
+	/* Incremented whenever acl_group[] is modified. */
+	unsigned int acl_group_generation[CCS_MAX_ACL_GROUPS];
+#endif
 	/* List for connecting to ccs_namespace_list list. */
 	struct list_head namespace_list;
 	/* Profile version. Currently only 20150505 is supported. */
@@ -1597,10 +2041,17 @@ char *ccs_encode(const char *str);
 char *ccs_encode2(const char *str, int str_len);
 char *ccs_realpath(const struct path *path);
 const char *ccs_get_exe(void);
+const struct ccs_bprm_strings *ccs_load_bprm(struct ccs_execve *ee);
 const struct ccs_path_info *ccs_get_name(const char *name);
 int ccs_audit_log(struct ccs_request_info *r);
 int ccs_check_acl(struct ccs_request_info *r);
 int ccs_init_request_info(struct ccs_request_info *r, const u8 index);
+int ccs_pin_cursor(struct ccs_io_buffer *head);
+int ccs_unlock_cursor(struct ccs_io_buffer *head);
+struct ccs_domain_index *ccs_build_domain_index
+(const struct ccs_domain_info *domain, const u8 type);
+struct ccs_domain_index *ccs_build_group_ranges(const struct ccs_group *group,
+						const u8 type);
 struct ccs_domain_info *ccs_assign_domain(const char *domainname,
 					  const bool transit);
 u8 ccs_get_config(const u8 profile, const u8 index);
@@ -1608,23 +2059,44 @@ void *ccs_commit_ok(void *data, const unsigned int size);
 void ccs_del_acl(struct list_head *element);
 void ccs_del_condition(struct list_head *element);
 void ccs_fill_path_info(struct ccs_path_info *ptr);
-void ccs_get_attributes(struct ccs_obj_info *obj);
+void ccs_forget_dedup_index(const struct list_head *list);
+void __init ccs_gc_init(void);
+void ccs_get_attributes(struct ccs_obj_info *obj, const u8 mask);
+void ccs_lock_cursor(void);
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+void ccs_touch_acl_list(struct ccs_policy_namespace *ns,
+			struct list_head *list);
+#endif
+void ccs_mark_garbage(struct ccs_policy_namespace *ns, struct list_head *list,
+		      const bool is_acl);
 void ccs_notify_gc(struct ccs_io_buffer *head, const bool is_register);
+void ccs_schedule_gc(void);
 void ccs_transition_failed(const char *domainname);
 void ccs_warn_oom(const char *function);
 void ccs_write_log(struct ccs_request_info *r, const char *fmt, ...)
 	__printf(2, 3);
 
+#ifdef CONFIG_CCSECURITY_LATENCY
+void ccs_record_latency(const u8 index, const u64 start);
+#endif
+
 /* Variable definition for internal use. */
 
 extern bool ccs_policy_loaded;
+extern bool ccs_txn_committed[CCS_TXN_SLOTS];
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+extern bool ccs_acl_profiling;
+#endif
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+extern bool ccs_auto_transition_used;
+#endif
 extern const char * const ccs_dif[CCS_MAX_DOMAIN_INFO_FLAGS];
 extern const u8 ccs_c2mac[CCS_MAX_CAPABILITY_INDEX];
 extern const u8 ccs_pn2mac[CCS_MAX_PATH_NUMBER_OPERATION];
 extern const u8 ccs_pnnn2mac[CCS_MAX_MKDEV_OPERATION];
 extern const u8 ccs_pp2mac[CCS_MAX_PATH2_OPERATION];
 extern struct ccs_domain_info ccs_kernel_domain;
-extern struct list_head ccs_condition_list;
+extern struct list_head ccs_condition_list[CCS_MAX_CONDITION_HASH];
 extern struct list_head ccs_domain_list;
 extern struct list_head ccs_name_list[CCS_MAX_HASH];
 extern struct list_head ccs_namespace_list;
@@ -1632,8 +2104,16 @@ extern struct mutex ccs_policy_lock;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 19)
 extern struct srcu_struct ccs_ss;
 #endif
+extern u8 ccs_txn_busy;
+extern u8 ccs_txn_slot;
+extern unsigned int ccs_acl_generation;
+extern unsigned long ccs_gc_dirty;
 extern unsigned int ccs_memory_quota[CCS_MAX_MEMORY_STAT];
 extern unsigned int ccs_memory_used[CCS_MAX_MEMORY_STAT];
+DECLARE_PER_CPU(struct ccs_stat_counter, ccs_stat_counter);
+#ifdef CONFIG_CCSECURITY_LATENCY
+DECLARE_STATIC_KEY_FALSE(ccs_latency_enabled);
+#endif
 
 /* Inlined functions for internal use. */
 
@@ -1651,12 +2131,43 @@ static inline bool ccs_pathcmp(const struct ccs_path_info *a,
 	return a->hash != b->hash || strcmp(a->name, b->name);
 }
 
+/**
+ * ccs_deleted - Check whether an ACL entry is invisible.
+ *
+ * @is_deleted: Value of "is_deleted" field of "struct ccs_acl_head" or
+ *              "struct ccs_acl_info".
+ *
+ * Returns true if the entry must be ignored, false otherwise.
+ *
+ * Entries staged by a transaction are kept in CCS_TXN_ADDED/CCS_TXN_DELETED
+ * state of the transaction's slot until commit, and a single store to
+ * ccs_txn_committed[] of that slot switches all of them at once.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static inline bool ccs_deleted(const s8 is_deleted)
+{
+	if (likely(is_deleted <= true))
+		return is_deleted;
+	smp_rmb(); /* Pairs with smp_wmb() in ccs_end_txn(). */
+	return !(is_deleted & 1) !=
+		ACCESS_ONCE(ccs_txn_committed[(is_deleted - 2) >> 1]);
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 19)
 
 /**
  * ccs_read_lock - Take lock for protecting policy.
  *
  * Returns index number for ccs_read_unlock().
+ *
+ * Every check which refers to policy holds this lock, even if the hook which
+ * called it never sleeps, for ccs_check_acl() may sleep for audit logs and
+ * supervisor queries whichever hook called it, and the garbage collector
+ * releases policy only after synchronize_srcu(). A plain RCU read side would
+ * need a second grace period for every element the garbage collector frees.
+ * Only ccs_socket_cache_granted_fast() checks without this lock, for cached
+ * datagram verdicts refer to no policy.
  */
 static inline int ccs_read_lock(void)
 {
@@ -1920,8 +2431,8 @@ static inline int ccs_round2(size_t size)
  */
 static inline void ccs_put_condition(struct ccs_condition *cond)
 {
-	if (cond)
-		atomic_dec(&cond->head.users);
+	if (cond && atomic_dec_and_test(&cond->head.users))
+		set_bit(CCS_GC_DIRTY_CONDITION, &ccs_gc_dirty);
 }
 
 /**
@@ -1933,8 +2444,8 @@ static inline void ccs_put_condition(struct ccs_condition *cond)
  */
 static inline void ccs_put_group(struct ccs_group *group)
 {
-	if (group)
-		atomic_dec(&group->head.users);
+	if (group && atomic_dec_and_test(&group->head.users))
+		set_bit(CCS_GC_DIRTY_GROUP, &ccs_gc_dirty);
 }
 
 /**
@@ -1946,9 +2457,9 @@ static inline void ccs_put_group(struct ccs_group *group)
  */
 static inline void ccs_put_name(const struct ccs_path_info *name)
 {
-	if (name)
-		atomic_dec(&container_of(name, struct ccs_name, entry)->
-			   head.users);
+	if (name && atomic_dec_and_test(&container_of(name, struct ccs_name,
+						       entry)->head.users))
+		set_bit(CCS_GC_DIRTY_NAME, &ccs_gc_dirty);
 }
 
 /* For importing variables and functions. */
@@ -1984,7 +2495,11 @@ struct ccs_security {
 };
 
 void __init ccs_main_init(void);
-bool ccs_used_by_cred(const struct ccs_domain_info *domain);
+void ccs_update_hooks(const u8 groups);
+#ifdef CONFIG_CCSECURITY_NETWORK
+void ccs_forget_socket_cache(const struct inode *inode);
+void ccs_grow_socket_cache(void);
+#endif
 int ccs_start_execve(struct linux_binprm *bprm, struct ccs_execve **eep);
 void ccs_finish_execve(int retval, struct ccs_execve *ee);
 void ccs_load_policy(const char *filename);
@@ -2152,6 +2667,50 @@ static inline u32 ccs_current_flags(void)
 
 #endif
 
+/**
+ * ccs_get_domain - Take a reference on "struct ccs_domain_info".
+ *
+ * @domain: Pointer to "struct ccs_domain_info". Maybe NULL.
+ *
+ * Returns nothing.
+ */
+static inline void ccs_get_domain(struct ccs_domain_info *domain)
+{
+	if (domain)
+		atomic_inc(&domain->users);
+}
+
+/**
+ * ccs_put_domain - Drop a reference on "struct ccs_domain_info".
+ *
+ * @domain: Pointer to "struct ccs_domain_info". Maybe NULL.
+ *
+ * Returns nothing.
+ */
+static inline void ccs_put_domain(struct ccs_domain_info *domain)
+{
+	if (domain && atomic_dec_and_test(&domain->users) &&
+	    domain->is_deleted)
+		set_bit(CCS_GC_DIRTY_DOMAIN, &ccs_gc_dirty);
+}
+
+/**
+ * ccs_set_domain - Change domain of "struct ccs_security".
+ *
+ * @security: Pointer to "struct ccs_security".
+ * @domain:   Pointer to "struct ccs_domain_info".
+ *
+ * Returns nothing.
+ */
+static inline void ccs_set_domain(struct ccs_security *security,
+				  struct ccs_domain_info *domain)
+{
+	struct ccs_domain_info *old_domain = security->ccs_domain_info;
+	ccs_get_domain(domain);
+	security->ccs_domain_info = domain;
+	ccs_put_domain(old_domain);
+}
+
 /**
  * ccs_current_namespace - Get "struct ccs_policy_namespace" for current thread.
  *
@@ -2162,4 +2721,70 @@ static inline struct ccs_policy_namespace *ccs_current_namespace(void)
 	return ccs_current_domain()->ns;
 }
 
+/*
+ * Add @count to @member of this CPU's "struct ccs_stat_counter", e.g.
+ * ccs_add_stat(perf[CCS_STAT_REALPATH], 1).
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 33)
+#define ccs_add_stat(member, count)					\
+	this_cpu_add(ccs_stat_counter.member, count)
+#else
+#define ccs_add_stat(member, count)					\
+	do {								\
+		get_cpu_var(ccs_stat_counter).member += (count);	\
+		put_cpu_var(ccs_stat_counter);				\
+	} while (0)
+#endif
+
+#ifdef CONFIG_CCSECURITY_LATENCY
+
+/**
+ * ccs_latency_start - Start measuring latency.
+ *
+ * Returns current local_clock() if /proc/ccs/latency is enabled, 0 otherwise.
+ */
+static inline u64 ccs_latency_start(void)
+{
+	return static_branch_unlikely(&ccs_latency_enabled) ? local_clock() : 0;
+}
+
+/**
+ * ccs_latency_end - Finish measuring latency.
+ *
+ * @index: One of values in "enum ccs_latency_index".
+ * @start: Return value of ccs_latency_start().
+ *
+ * Returns nothing.
+ */
+static inline void ccs_latency_end(const u8 index, const u64 start)
+{
+	if (static_branch_unlikely(&ccs_latency_enabled) && start)
+		ccs_record_latency(index, start);
+}
+
+#else
+
+static inline u64 ccs_latency_start(void)
+{
+	return 0;
+}
+
+static inline void ccs_latency_end(const u8 index, const u64 start)
+{
+}
+
+#endif
+
+/*
+ * Evaluate an int expression, recording its latency into the histogram for
+ * @index if /proc/ccs/latency is enabled.
+ */
+#define ccs_latency(index, expr)					\
+	({								\
+		const u64 ccs_start__ = ccs_latency_start();		\
+		const int ccs_ret__ = (expr);				\
+		ccs_latency_end(index, ccs_start__);			\
+		ccs_ret__;						\
+	})
+
 #endif
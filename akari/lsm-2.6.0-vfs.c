@@ -1025,15 +1025,18 @@ static int ccs_socket_shutdown(struct socket *sock, int how)
  *
  * Returns nothing.
  *
- * We use this hook for releasing memory associated with an accept()ed socket.
+ * We use this hook for releasing memory associated with an accept()ed socket
+ * and granted datagram peers of a socket.
  */
 static void ccs_inode_free_security(struct inode *inode)
 {
 	while (!original_security_ops.inode_free_security)
 		smp_rmb();
 	original_security_ops.inode_free_security(inode);
-	if (inode->i_sb && inode->i_sb->s_magic == SOCKFS_MAGIC)
+	if (inode->i_sb && inode->i_sb->s_magic == SOCKFS_MAGIC) {
 		ccs_update_socket_tag(inode, 0);
+		ccs_forget_socket_cache(inode);
+	}
 }
 
 #endif
@@ -1434,17 +1437,16 @@ module_init(ccs_init);
 MODULE_LICENSE("GPL");
 
 /**
- * ccs_used_by_cred - Check whether the given domain is in use or not.
+ * ccs_update_hooks - Enable/disable optional LSM hooks.
  *
- * @domain: Pointer to "struct ccs_domain_info".
+ * @groups: Bitmask of "enum ccs_hook_group_index" which need to be enabled.
  *
- * Returns true if @domain is in use, false otherwise.
+ * Returns nothing.
  *
- * Caller holds rcu_read_lock().
+ * All hooks are always enabled on this kernel version.
  */
-bool ccs_used_by_cred(const struct ccs_domain_info *domain)
+void ccs_update_hooks(const u8 groups)
 {
-	return false;
 }
 
 /**
@@ -1481,7 +1483,7 @@ static int __ccs_alloc_task_security(const struct task_struct *task)
 	if (!new_security)
 		return -ENOMEM;
 	new_security->task = task;
-	new_security->ccs_domain_info = old_security->ccs_domain_info;
+	ccs_set_domain(new_security, old_security->ccs_domain_info);
 	new_security->ccs_flags = old_security->ccs_flags;
 	ccs_add_task_security(new_security, list);
 	return 0;
@@ -1579,6 +1581,7 @@ static void __ccs_free_task_security(const struct task_struct *task)
 	spin_lock_irqsave(&ccs_task_security_list_lock, flags);
 	list_del_rcu(&ptr->list);
 	spin_unlock_irqrestore(&ccs_task_security_list_lock, flags);
+	ccs_put_domain(ptr->ccs_domain_info);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 8)
 	call_rcu(&ptr->rcu, ccs_rcu_free);
 #else
@@ -8,6 +8,7 @@
 
 #include "internal.h"
 #include "probe.h"
+#include <linux/jump_label.h>
 
 /* Prototype definition. */
 static int __ccs_alloc_task_security(const struct task_struct *task);
@@ -38,6 +39,17 @@ static union security_list_options original_cred_prepare;
 static union security_list_options original_task_alloc;
 static union security_list_options original_task_free;
 
+/*
+ * Whether some profile enables functionality checked by each group of hooks
+ * in "enum ccs_hook_group_index". Hooks are always registered; these keys
+ * only let disabled groups return without doing any work.
+ */
+static struct static_key_false ccs_hook_enabled[CCS_MAX_HOOK_GROUP] = {
+	[0 ... CCS_MAX_HOOK_GROUP - 1] = STATIC_KEY_FALSE_INIT
+};
+
+#define ccs_hook_wanted(group) static_branch_unlikely(&ccs_hook_enabled[group])
+
 #ifdef CONFIG_AKARI_TRACE_EXECVE_COUNT
 
 /**
@@ -164,6 +176,7 @@ static void ccs_task_free_security(struct task_struct *p)
 	if (ee) {
 		ccs_debug_trace("2");
 		ccs_audit_free_execve(ee, false);
+		ccs_put_domain(ee->previous_domain);
 		kfree(ee->handler_path);
 		kfree(ee);
 		ptr->ee = NULL;
@@ -225,7 +238,8 @@ static int ccs_bprm_check_security(struct linux_binprm *bprm)
 	if (!ccs_policy_loaded)
 		ccs_load_policy(bprm->filename);
 #endif
-	return ccs_start_execve(bprm, &security->ee);
+	return ccs_latency(CCS_LATENCY_BPRM_CHECK,
+			   ccs_start_execve(bprm, &security->ee));
 }
 
 /**
@@ -238,7 +252,7 @@ static int ccs_bprm_check_security(struct linux_binprm *bprm)
  */
 static int ccs_file_open(struct file *f, const struct cred *cred)
 {
-	return ccs_open_permission(f);
+	return ccs_latency(CCS_LATENCY_FILE_OPEN, ccs_open_permission(f));
 }
 
 #ifdef CONFIG_SECURITY_PATH
@@ -254,7 +268,9 @@ static int ccs_file_open(struct file *f, const struct cred *cred)
  */
 static int ccs_path_chown(const struct path *path, kuid_t user, kgid_t group)
 {
-	return ccs_chown_permission(path->dentry, path->mnt, user, group);
+	return ccs_latency(CCS_LATENCY_CHOWN,
+			   ccs_chown_permission(path->dentry, path->mnt, user,
+						group));
 }
 
 /**
@@ -267,7 +283,8 @@ static int ccs_path_chown(const struct path *path, kuid_t user, kgid_t group)
  */
 static int ccs_path_chmod(const struct path *path, umode_t mode)
 {
-	return ccs_chmod_permission(path->dentry, path->mnt, mode);
+	return ccs_latency(CCS_LATENCY_CHMOD,
+			   ccs_chmod_permission(path->dentry, path->mnt, mode));
 }
 
 /**
@@ -279,7 +296,7 @@ static int ccs_path_chmod(const struct path *path, umode_t mode)
  */
 static int ccs_path_chroot(const struct path *path)
 {
-	return ccs_chroot_permission(path);
+	return ccs_latency(CCS_LATENCY_CHROOT, ccs_chroot_permission(path));
 }
 
 /**
@@ -291,7 +308,8 @@ static int ccs_path_chroot(const struct path *path)
  */
 static int ccs_path_truncate(const struct path *path)
 {
-	return ccs_truncate_permission(path->dentry, path->mnt);
+	return ccs_latency(CCS_LATENCY_TRUNCATE,
+			   ccs_truncate_permission(path->dentry, path->mnt));
 }
 
 #else
@@ -306,6 +324,7 @@ static int ccs_path_truncate(const struct path *path)
  */
 static int ccs_inode_setattr(struct dentry *dentry, struct iattr *attr)
 {
+	const u64 start = ccs_latency_start();
 	const int rc1 = (attr->ia_valid & ATTR_UID) ?
 		ccs_chown_permission(dentry, NULL, attr->ia_uid, INVALID_GID) :
 		0;
@@ -316,6 +335,7 @@ static int ccs_inode_setattr(struct dentry *dentry, struct iattr *attr)
 		ccs_chmod_permission(dentry, NULL, attr->ia_mode) : 0;
 	const int rc4 = (attr->ia_valid & ATTR_SIZE) ?
 		ccs_truncate_permission(dentry, NULL) : 0;
+	ccs_latency_end(CCS_LATENCY_INODE_SETATTR, start);
 	if (rc4)
 		return rc4;
 	if (rc3)
@@ -336,7 +356,10 @@ static int ccs_inode_setattr(struct dentry *dentry, struct iattr *attr)
  */
 static int ccs_inode_getattr(const struct path *path)
 {
-	return ccs_getattr_permission(path->mnt, path->dentry);
+	if (!ccs_hook_wanted(CCS_HOOK_FILE_GETATTR))
+		return 0;
+	return ccs_latency(CCS_LATENCY_INODE_GETATTR,
+			   ccs_getattr_permission(path->mnt, path->dentry));
 }
 
 #ifdef CONFIG_SECURITY_PATH
@@ -354,7 +377,8 @@ static int ccs_inode_getattr(const struct path *path)
 static int ccs_path_mknod(const struct path *dir, struct dentry *dentry,
 			  umode_t mode, unsigned int dev)
 {
-	return ccs_mknod_permission(dentry, dir->mnt, mode, dev);
+	return ccs_latency(CCS_LATENCY_MKNOD,
+			   ccs_mknod_permission(dentry, dir->mnt, mode, dev));
 }
 
 /**
@@ -369,7 +393,8 @@ static int ccs_path_mknod(const struct path *dir, struct dentry *dentry,
 static int ccs_path_mkdir(const struct path *dir, struct dentry *dentry,
 			  umode_t mode)
 {
-	return ccs_mkdir_permission(dentry, dir->mnt, mode);
+	return ccs_latency(CCS_LATENCY_MKDIR,
+			   ccs_mkdir_permission(dentry, dir->mnt, mode));
 }
 
 /**
@@ -382,7 +407,8 @@ static int ccs_path_mkdir(const struct path *dir, struct dentry *dentry,
  */
 static int ccs_path_rmdir(const struct path *dir, struct dentry *dentry)
 {
-	return ccs_rmdir_permission(dentry, dir->mnt);
+	return ccs_latency(CCS_LATENCY_RMDIR,
+			   ccs_rmdir_permission(dentry, dir->mnt));
 }
 
 /**
@@ -395,7 +421,8 @@ static int ccs_path_rmdir(const struct path *dir, struct dentry *dentry)
  */
 static int ccs_path_unlink(const struct path *dir, struct dentry *dentry)
 {
-	return ccs_unlink_permission(dentry, dir->mnt);
+	return ccs_latency(CCS_LATENCY_UNLINK,
+			   ccs_unlink_permission(dentry, dir->mnt));
 }
 
 /**
@@ -410,7 +437,8 @@ static int ccs_path_unlink(const struct path *dir, struct dentry *dentry)
 static int ccs_path_symlink(const struct path *dir, struct dentry *dentry,
 			    const char *old_name)
 {
-	return ccs_symlink_permission(dentry, dir->mnt, old_name);
+	return ccs_latency(CCS_LATENCY_SYMLINK,
+			   ccs_symlink_permission(dentry, dir->mnt, old_name));
 }
 
 /**
@@ -428,7 +456,9 @@ static int ccs_path_rename(const struct path *old_dir,
 			   const struct path *new_dir,
 			   struct dentry *new_dentry)
 {
-	return ccs_rename_permission(old_dentry, new_dentry, old_dir->mnt);
+	return ccs_latency(CCS_LATENCY_RENAME,
+			   ccs_rename_permission(old_dentry, new_dentry,
+						 old_dir->mnt));
 }
 
 /**
@@ -443,7 +473,9 @@ static int ccs_path_rename(const struct path *old_dir,
 static int ccs_path_link(struct dentry *old_dentry, const struct path *new_dir,
 			 struct dentry *new_dentry)
 {
-	return ccs_link_permission(old_dentry, new_dentry, new_dir->mnt);
+	return ccs_latency(CCS_LATENCY_LINK,
+			   ccs_link_permission(old_dentry, new_dentry,
+					       new_dir->mnt));
 }
 
 #else
@@ -461,7 +493,8 @@ static int ccs_path_link(struct dentry *old_dentry, const struct path *new_dir,
 static int ccs_inode_mknod(struct inode *dir, struct dentry *dentry,
 			   umode_t mode, dev_t dev)
 {
-	return ccs_mknod_permission(dentry, NULL, mode, dev);
+	return ccs_latency(CCS_LATENCY_MKNOD,
+			   ccs_mknod_permission(dentry, NULL, mode, dev));
 }
 
 /**
@@ -476,7 +509,8 @@ static int ccs_inode_mknod(struct inode *dir, struct dentry *dentry,
 static int ccs_inode_mkdir(struct inode *dir, struct dentry *dentry,
 			   umode_t mode)
 {
-	return ccs_mkdir_permission(dentry, NULL, mode);
+	return ccs_latency(CCS_LATENCY_MKDIR,
+			   ccs_mkdir_permission(dentry, NULL, mode));
 }
 
 /**
@@ -489,7 +523,8 @@ static int ccs_inode_mkdir(struct inode *dir, struct dentry *dentry,
  */
 static int ccs_inode_rmdir(struct inode *dir, struct dentry *dentry)
 {
-	return ccs_rmdir_permission(dentry, NULL);
+	return ccs_latency(CCS_LATENCY_RMDIR,
+			   ccs_rmdir_permission(dentry, NULL));
 }
 
 /**
@@ -502,7 +537,8 @@ static int ccs_inode_rmdir(struct inode *dir, struct dentry *dentry)
  */
 static int ccs_inode_unlink(struct inode *dir, struct dentry *dentry)
 {
-	return ccs_unlink_permission(dentry, NULL);
+	return ccs_latency(CCS_LATENCY_UNLINK,
+			   ccs_unlink_permission(dentry, NULL));
 }
 
 /**
@@ -517,7 +553,8 @@ static int ccs_inode_unlink(struct inode *dir, struct dentry *dentry)
 static int ccs_inode_symlink(struct inode *dir, struct dentry *dentry,
 			     const char *old_name)
 {
-	return ccs_symlink_permission(dentry, NULL, old_name);
+	return ccs_latency(CCS_LATENCY_SYMLINK,
+			   ccs_symlink_permission(dentry, NULL, old_name));
 }
 
 /**
@@ -533,7 +570,8 @@ static int ccs_inode_symlink(struct inode *dir, struct dentry *dentry,
 static int ccs_inode_rename(struct inode *old_dir, struct dentry *old_dentry,
 			    struct inode *new_dir, struct dentry *new_dentry)
 {
-	return ccs_rename_permission(old_dentry, new_dentry, NULL);
+	return ccs_latency(CCS_LATENCY_RENAME,
+			   ccs_rename_permission(old_dentry, new_dentry, NULL));
 }
 
 /**
@@ -548,7 +586,8 @@ static int ccs_inode_rename(struct inode *old_dir, struct dentry *old_dentry,
 static int ccs_inode_link(struct dentry *old_dentry, struct inode *dir,
 			  struct dentry *new_dentry)
 {
-	return ccs_link_permission(old_dentry, new_dentry, NULL);
+	return ccs_latency(CCS_LATENCY_LINK,
+			   ccs_link_permission(old_dentry, new_dentry, NULL));
 }
 
 /**
@@ -563,7 +602,8 @@ static int ccs_inode_link(struct dentry *old_dentry, struct inode *dir,
 static int ccs_inode_create(struct inode *dir, struct dentry *dentry,
 			    umode_t mode)
 {
-	return ccs_mknod_permission(dentry, NULL, mode, 0);
+	return ccs_latency(CCS_LATENCY_MKNOD,
+			   ccs_mknod_permission(dentry, NULL, mode, 0));
 }
 
 #endif
@@ -689,13 +729,19 @@ static int ccs_validate_socket(struct socket *sock)
  * rather than between sock->ops->accept() and returning to userspace.
  * This means that if a socket was close()d before calling some socket
  * syscalls, post accept() permission check will not be done.
+ *
+ * "newsock" is marked even if no profile enables network functionality, for
+ * it might be enabled before "newsock" is used.
  */
 static int ccs_socket_accept(struct socket *sock, struct socket *newsock)
 {
 	struct ccs_socket_tag *ptr;
-	const int rc = ccs_validate_socket(sock);
-	if (rc < 0)
-		return rc;
+	if (ccs_hook_wanted(CCS_HOOK_NETWORK)) {
+		const int rc = ccs_latency(CCS_LATENCY_SOCKET_ACCEPT,
+					   ccs_validate_socket(sock));
+		if (rc < 0)
+			return rc;
+	}
 	ptr = kzalloc(sizeof(*ptr), GFP_KERNEL);
 	if (!ptr)
 		return -ENOMEM;
@@ -723,10 +769,16 @@ static int ccs_socket_accept(struct socket *sock, struct socket *newsock)
  */
 static int ccs_socket_listen(struct socket *sock, int backlog)
 {
-	const int rc = ccs_validate_socket(sock);
-	if (rc < 0)
-		return rc;
-	return ccs_socket_listen_permission(sock);
+	u64 start;
+	int rc;
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	start = ccs_latency_start();
+	rc = ccs_validate_socket(sock);
+	if (rc >= 0)
+		rc = ccs_socket_listen_permission(sock);
+	ccs_latency_end(CCS_LATENCY_SOCKET_LISTEN, start);
+	return rc;
 }
 
 /**
@@ -741,10 +793,16 @@ static int ccs_socket_listen(struct socket *sock, int backlog)
 static int ccs_socket_connect(struct socket *sock, struct sockaddr *addr,
 			      int addr_len)
 {
-	const int rc = ccs_validate_socket(sock);
-	if (rc < 0)
-		return rc;
-	return ccs_socket_connect_permission(sock, addr, addr_len);
+	u64 start;
+	int rc;
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	start = ccs_latency_start();
+	rc = ccs_validate_socket(sock);
+	if (rc >= 0)
+		rc = ccs_socket_connect_permission(sock, addr, addr_len);
+	ccs_latency_end(CCS_LATENCY_SOCKET_CONNECT, start);
+	return rc;
 }
 
 /**
@@ -759,10 +817,16 @@ static int ccs_socket_connect(struct socket *sock, struct sockaddr *addr,
 static int ccs_socket_bind(struct socket *sock, struct sockaddr *addr,
 			   int addr_len)
 {
-	const int rc = ccs_validate_socket(sock);
-	if (rc < 0)
-		return rc;
-	return ccs_socket_bind_permission(sock, addr, addr_len);
+	u64 start;
+	int rc;
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	start = ccs_latency_start();
+	rc = ccs_validate_socket(sock);
+	if (rc >= 0)
+		rc = ccs_socket_bind_permission(sock, addr, addr_len);
+	ccs_latency_end(CCS_LATENCY_SOCKET_BIND, start);
+	return rc;
 }
 
 /**
@@ -777,10 +841,16 @@ static int ccs_socket_bind(struct socket *sock, struct sockaddr *addr,
 static int ccs_socket_sendmsg(struct socket *sock, struct msghdr *msg,
 			      int size)
 {
-	const int rc = ccs_validate_socket(sock);
-	if (rc < 0)
-		return rc;
-	return ccs_socket_sendmsg_permission(sock, msg, size);
+	u64 start;
+	int rc;
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	start = ccs_latency_start();
+	rc = ccs_validate_socket(sock);
+	if (rc >= 0)
+		rc = ccs_socket_sendmsg_permission(sock, msg, size);
+	ccs_latency_end(CCS_LATENCY_SOCKET_SENDMSG, start);
+	return rc;
 }
 
 /**
@@ -796,7 +866,10 @@ static int ccs_socket_sendmsg(struct socket *sock, struct msghdr *msg,
 static int ccs_socket_recvmsg(struct socket *sock, struct msghdr *msg,
 			      int size, int flags)
 {
-	return ccs_validate_socket(sock);
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	return ccs_latency(CCS_LATENCY_SOCKET_RECVMSG,
+			   ccs_validate_socket(sock));
 }
 
 /**
@@ -808,7 +881,10 @@ static int ccs_socket_recvmsg(struct socket *sock, struct msghdr *msg,
  */
 static int ccs_socket_getsockname(struct socket *sock)
 {
-	return ccs_validate_socket(sock);
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	return ccs_latency(CCS_LATENCY_SOCKET_GETSOCKNAME,
+			   ccs_validate_socket(sock));
 }
 
 /**
@@ -820,7 +896,10 @@ static int ccs_socket_getsockname(struct socket *sock)
  */
 static int ccs_socket_getpeername(struct socket *sock)
 {
-	return ccs_validate_socket(sock);
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	return ccs_latency(CCS_LATENCY_SOCKET_GETPEERNAME,
+			   ccs_validate_socket(sock));
 }
 
 /**
@@ -834,7 +913,10 @@ static int ccs_socket_getpeername(struct socket *sock)
  */
 static int ccs_socket_getsockopt(struct socket *sock, int level, int optname)
 {
-	return ccs_validate_socket(sock);
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	return ccs_latency(CCS_LATENCY_SOCKET_GETSOCKOPT,
+			   ccs_validate_socket(sock));
 }
 
 /**
@@ -848,7 +930,10 @@ static int ccs_socket_getsockopt(struct socket *sock, int level, int optname)
  */
 static int ccs_socket_setsockopt(struct socket *sock, int level, int optname)
 {
-	return ccs_validate_socket(sock);
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	return ccs_latency(CCS_LATENCY_SOCKET_SETSOCKOPT,
+			   ccs_validate_socket(sock));
 }
 
 /**
@@ -861,7 +946,10 @@ static int ccs_socket_setsockopt(struct socket *sock, int level, int optname)
  */
 static int ccs_socket_shutdown(struct socket *sock, int how)
 {
-	return ccs_validate_socket(sock);
+	if (!ccs_hook_wanted(CCS_HOOK_NETWORK))
+		return 0;
+	return ccs_latency(CCS_LATENCY_SOCKET_SHUTDOWN,
+			   ccs_validate_socket(sock));
 }
 
 #define SOCKFS_MAGIC 0x534F434B
@@ -873,12 +961,15 @@ static int ccs_socket_shutdown(struct socket *sock, int how)
  *
  * Returns nothing.
  *
- * We use this hook for releasing memory associated with an accept()ed socket.
+ * We use this hook for releasing memory associated with an accept()ed socket
+ * and granted datagram peers of a socket.
  */
 static void ccs_inode_free_security(struct inode *inode)
 {
-	if (inode->i_sb && inode->i_sb->s_magic == SOCKFS_MAGIC)
+	if (inode->i_sb && inode->i_sb->s_magic == SOCKFS_MAGIC) {
 		ccs_update_socket_tag(inode, 0);
+		ccs_forget_socket_cache(inode);
+	}
 }
 
 #endif
@@ -894,7 +985,8 @@ static void ccs_inode_free_security(struct inode *inode)
 static int ccs_sb_pivotroot(const struct path *old_path,
 			    const struct path *new_path)
 {
-	return ccs_pivot_root_permission(old_path, new_path);
+	return ccs_latency(CCS_LATENCY_SB_PIVOTROOT,
+			   ccs_pivot_root_permission(old_path, new_path));
 }
 
 /**
@@ -911,7 +1003,9 @@ static int ccs_sb_pivotroot(const struct path *old_path,
 static int ccs_sb_mount(const char *dev_name, const struct path *path,
 			const char *type, unsigned long flags, void *data_page)
 {
-	return ccs_mount_permission(dev_name, path, type, flags, data_page);
+	return ccs_latency(CCS_LATENCY_SB_MOUNT,
+			   ccs_mount_permission(dev_name, path, type, flags,
+						data_page));
 }
 
 /**
@@ -924,7 +1018,8 @@ static int ccs_sb_mount(const char *dev_name, const struct path *path,
  */
 static int ccs_sb_umount(struct vfsmount *mnt, int flags)
 {
-	return ccs_umount_permission(mnt, flags);
+	return ccs_latency(CCS_LATENCY_SB_UMOUNT,
+			   ccs_umount_permission(mnt, flags));
 }
 
 /**
@@ -939,7 +1034,8 @@ static int ccs_sb_umount(struct vfsmount *mnt, int flags)
 static int ccs_file_fcntl(struct file *file, unsigned int cmd,
 			  unsigned long arg)
 {
-	return ccs_fcntl_permission(file, cmd, arg);
+	return ccs_latency(CCS_LATENCY_FILE_FCNTL,
+			   ccs_fcntl_permission(file, cmd, arg));
 }
 
 /**
@@ -954,7 +1050,10 @@ static int ccs_file_fcntl(struct file *file, unsigned int cmd,
 static int ccs_file_ioctl(struct file *filp, unsigned int cmd,
 			  unsigned long arg)
 {
-	return ccs_ioctl_permission(filp, cmd, arg);
+	if (!ccs_hook_wanted(CCS_HOOK_FILE_IOCTL))
+		return 0;
+	return ccs_latency(CCS_LATENCY_FILE_IOCTL,
+			   ccs_ioctl_permission(filp, cmd, arg));
 }
 
 #define MY_HOOK_INIT(HEAD, HOOK)				\
@@ -1072,9 +1171,9 @@ static bool __init check_ro_pages(struct security_hook_heads *hooks)
 
 	if (!probe_kernel_write(&list->next, list->next, sizeof(void *)))
 		return true;
-	for (i = 0; i < ARRAY_SIZE(akari_hooks); i++) {
+	for (i = 0; i < CCS_NR_HOOKS; i++) {
 		const unsigned int idx =
-			((unsigned long) akari_hooks[i].head
+			((unsigned long) ccs_nth_hook(i)->head
 			 - (unsigned long) hooks)
 			/ sizeof(struct list_head);
 		struct list_head *self = &list[idx];
@@ -1159,17 +1258,26 @@ module_init(ccs_init);
 MODULE_LICENSE("GPL");
 
 /**
- * ccs_used_by_cred - Check whether the given domain is in use or not.
+ * ccs_update_hooks - Enable/disable optional LSM hooks.
+ *
+ * @groups: Bitmask of "enum ccs_hook_group_index" which need to be enabled.
  *
- * @domain: Pointer to "struct ccs_domain_info".
+ * Returns nothing.
  *
- * Returns true if @domain is in use, false otherwise.
+ * Caller serializes calls to this function.
  *
- * Caller holds rcu_read_lock().
+ * security_hook_heads is never modified after ccs_init(), for the LSM
+ * framework traverses it without holding any lock and the hooks may sleep.
  */
-bool ccs_used_by_cred(const struct ccs_domain_info *domain)
+void ccs_update_hooks(const u8 groups)
 {
-	return false;
+	u8 i;
+	for (i = 0; i < CCS_MAX_HOOK_GROUP; i++) {
+		if (groups & (1 << i))
+			static_branch_enable(&ccs_hook_enabled[i]);
+		else
+			static_branch_disable(&ccs_hook_enabled[i]);
+	}
 }
 
 /**
@@ -1206,7 +1314,7 @@ static int __ccs_alloc_task_security(const struct task_struct *task)
 	if (!new_security)
 		return -ENOMEM;
 	new_security->task = task;
-	new_security->ccs_domain_info = old_security->ccs_domain_info;
+	ccs_set_domain(new_security, old_security->ccs_domain_info);
 	new_security->ccs_flags = old_security->ccs_flags;
 	ccs_add_task_security(new_security, list);
 	return 0;
@@ -1300,5 +1408,6 @@ static void __ccs_free_task_security(const struct task_struct *task)
 	spin_lock_irqsave(&ccs_task_security_list_lock, flags);
 	list_del_rcu(&ptr->list);
 	spin_unlock_irqrestore(&ccs_task_security_list_lock, flags);
+	ccs_put_domain(ptr->ccs_domain_info);
 	kfree_rcu(ptr, rcu);
 }
@@ -174,9 +174,11 @@ static void ccs_rcu_free(struct rcu_head *rcu)
 	if (ee) {
 		ccs_debug_trace("3");
 		ccs_audit_free_execve(ee, false);
+		ccs_put_domain(ee->previous_domain);
 		kfree(ee->handler_path);
 		kfree(ee);
 	}
+	ccs_put_domain(ptr->ccs_domain_info);
 	kfree(ptr);
 }
 
@@ -237,7 +239,7 @@ static int ccs_task_create(unsigned long clone_flags)
 		return -ENOMEM;
 	old_security = ccs_find_task_security(current);
 	new_security = ccs_find_cred_security(cred);
-	new_security->ccs_domain_info = old_security->ccs_domain_info;
+	ccs_set_domain(new_security, old_security->ccs_domain_info);
 	new_security->ccs_flags = old_security->ccs_flags;
 	return commit_creds(cred);
 }
@@ -349,7 +351,7 @@ static void ccs_cred_transfer(struct cred *new, const struct cred *old)
 	    old_security == &ccs_oom_security)
 		return;
 	new_security->ccs_flags = old_security->ccs_flags;
-	new_security->ccs_domain_info = old_security->ccs_domain_info;
+	ccs_set_domain(new_security, old_security->ccs_domain_info);
 }
 
 /**
@@ -370,7 +372,7 @@ static void ccs_bprm_committing_creds(struct linux_binprm *bprm)
 	/* Update current task's cred's domain for future fork(). */
 	new_security = ccs_find_cred_security(bprm->cred);
 	new_security->ccs_flags = old_security->ccs_flags;
-	new_security->ccs_domain_info = old_security->ccs_domain_info;
+	ccs_set_domain(new_security, old_security->ccs_domain_info);
 }
 
 /**
@@ -1043,12 +1045,15 @@ static int ccs_socket_shutdown(struct socket *sock, int how)
  *
  * Returns nothing.
  *
- * We use this hook for releasing memory associated with an accept()ed socket.
+ * We use this hook for releasing memory associated with an accept()ed socket
+ * and granted datagram peers of a socket.
  */
 static void ccs_inode_free_security(struct inode *inode)
 {
-	if (inode->i_sb && inode->i_sb->s_magic == SOCKFS_MAGIC)
+	if (inode->i_sb && inode->i_sb->s_magic == SOCKFS_MAGIC) {
 		ccs_update_socket_tag(inode, 0);
+		ccs_forget_socket_cache(inode);
+	}
 }
 
 #endif
@@ -1254,29 +1259,16 @@ module_init(ccs_init);
 MODULE_LICENSE("GPL");
 
 /**
- * ccs_used_by_cred - Check whether the given domain is in use or not.
+ * ccs_update_hooks - Enable/disable optional LSM hooks.
  *
- * @domain: Pointer to "struct ccs_domain_info".
+ * @groups: Bitmask of "enum ccs_hook_group_index" which need to be enabled.
  *
- * Returns true if @domain is in use, false otherwise.
+ * Returns nothing.
  *
- * Caller holds rcu_read_lock().
+ * All hooks are always enabled on this kernel version.
  */
-bool ccs_used_by_cred(const struct ccs_domain_info *domain)
+void ccs_update_hooks(const u8 groups)
 {
-	int idx;
-	struct ccs_security *ptr;
-	for (idx = 0; idx < CCS_MAX_TASK_SECURITY_HASH; idx++) {
-		struct list_head *list = &ccs_cred_security_list[idx];
-		list_for_each_entry_rcu(ptr, list, list) {
-			struct ccs_execve *ee = ptr->ee;
-			if (ptr->ccs_domain_info == domain ||
-			    (ee && ee->previous_domain == domain)) {
-				return true;
-			}
-		}
-	}
-	return false;
 }
 
 /**
@@ -1382,6 +1374,7 @@ struct ccs_security *ccs_find_task_security(const struct task_struct *task)
 		return &ccs_oom_security;
 	}
 	*ptr = *ccs_find_cred_security(task->cred);
+	ccs_get_domain(ptr->ccs_domain_info);
 	/* We can shortcut because task == current. */
 	ptr->pid = get_pid(((struct task_struct *) task)->
 			   pids[PIDTYPE_PID].pid);
@@ -1408,6 +1401,7 @@ static int ccs_copy_cred_security(const struct cred *new,
 	if (!new_security)
 		return -ENOMEM;
 	*new_security = *old_security;
+	ccs_get_domain(new_security->ccs_domain_info);
 	new_security->cred = new;
 	ccs_add_cred_security(new_security);
 	return 0;
@@ -42,10 +42,10 @@ static void ccs_rcu_free(void *arg);
 
 /***** SECTION5: Variables definition section *****/
 
-/* Memoy currently used by policy/audit log/query. */
+/* Memoy currently used by policy/audit log/query/socket cache. */
 unsigned int ccs_memory_used[CCS_MAX_MEMORY_STAT];
 
-/* Memory quota for "policy"/"audit log"/"query". */
+/* Memory quota for "policy"/"audit log"/"query"/"socket cache". */
 unsigned int ccs_memory_quota[CCS_MAX_MEMORY_STAT];
 
 /* The list for "struct ccs_name". */
@@ -232,7 +232,7 @@ static int __ccs_alloc_task_security(const struct task_struct *task)
 	if (!new_security)
 		return -ENOMEM;
 	new_security->task = task;
-	new_security->ccs_domain_info = old_security->ccs_domain_info;
+	ccs_set_domain(new_security, old_security->ccs_domain_info);
 	new_security->ccs_flags = old_security->ccs_flags;
 	ccs_add_task_security(new_security, list);
 	return 0;
@@ -330,6 +330,7 @@ static void __ccs_free_task_security(const struct task_struct *task)
 	spin_lock_irqsave(&ccs_task_security_list_lock, flags);
 	list_del_rcu(&ptr->list);
 	spin_unlock_irqrestore(&ccs_task_security_list_lock, flags);
+	ccs_put_domain(ptr->ccs_domain_info);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 8)
 	call_rcu(&ptr->rcu, ccs_rcu_free);
 #else
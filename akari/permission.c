@@ -7,6 +7,8 @@
  */
 
 #include "internal.h"
+#define CREATE_TRACE_POINTS
+#include "trace.h"
 
 /***** SECTION1: Constants definition *****/
 
@@ -31,6 +33,18 @@
 
 #endif
 
+#ifdef CONFIG_CCSECURITY_NETWORK
+
+/* Initial size of hash table for finding "struct ccs_socket_cache". */
+#define CCS_SOCKET_CACHE_HASH_BITS 8
+#define CCS_MAX_SOCKET_CACHE_HASH (1u << CCS_SOCKET_CACHE_HASH_BITS)
+/* Largest size of the hash table, which has to fit in kmalloc(). */
+#define CCS_SOCKET_CACHE_HASH_MAX_BITS 16
+/* Number of granted datagram peers remembered per a socket. */
+#define CCS_SOCKET_CACHE_WAYS 4
+
+#endif
+
 /* String table for special mount operations. */
 static const char * const ccs_mounts[CCS_MAX_SPECIAL_MOUNT] = {
 	[CCS_MOUNT_BIND]            = "--bind",
@@ -184,13 +198,115 @@ struct ccs_addr_info {
 	u8 operation;
 	struct ccs_inet_addr_info inet;
 	struct ccs_unix_addr_info unix0;
+	/*
+	 * Inode of the socket. Valid only if @operation is CCS_NETWORK_SEND or
+	 * CCS_NETWORK_RECV. Maybe NULL.
+	 */
+	const struct inode *inode;
+};
+
+/* Structure for a merged range of "struct ccs_number_group" members. */
+struct ccs_number_range {
+	unsigned long min;
+	unsigned long max;
+};
+
+#ifdef CONFIG_CCSECURITY_NETWORK
+
+/* Structure for a merged range of "struct ccs_address_group" members. */
+struct ccs_address_range {
+	u8 min[16]; /* In network byte order. Zero padded for IPv4. */
+	u8 max[16]; /* In network byte order. Zero padded for IPv4. */
+};
+
+#endif
+
+/* Structure for sorted and merged members of a number/address group. */
+struct ccs_group_ranges {
+	struct ccs_domain_index head;
+	/* Number of elements, indexed by is_ipv6 for address groups. */
+	unsigned int count[2];
+	struct ccs_number_range *number;
+#ifdef CONFIG_CCSECURITY_NETWORK
+	struct ccs_address_range *address[2];
+#endif
+};
+
+#ifdef CONFIG_CCSECURITY_NETWORK
+
+/* Structure for an address range of an inet ACL entry without conditions. */
+struct ccs_inet_range {
+	u8 min[16];        /* In network byte order. Zero padded for IPv4. */
+	u8 max[16];        /* In network byte order. Zero padded for IPv4. */
+	u8 max_so_far[16]; /* Largest "max" in this and preceding elements. */
+	const struct ccs_inet_acl *acl;
+};
+
+/* Structure for looking up inet ACL entries by address. */
+struct ccs_inet_index {
+	struct ccs_domain_index head;
+	/* Arrays sorted by "min", indexed by operation and is_ipv6. */
+	struct ccs_inet_range *range[CCS_MAX_NETWORK_OPERATION][2];
+	unsigned int count[CCS_MAX_NETWORK_OPERATION][2];
+};
+
+/* Structure for remembering a datagram peer granted without conditions. */
+struct ccs_socket_verdict {
+	/* "struct ccs_domain_info"->serial of the granted domain. */
+	unsigned int domain;
+	/* Value of ccs_acl_generation when this peer was granted. */
+	unsigned int generation;
+	u8 address[16]; /* In network byte order. Zero padded for IPv4. */
+	u16 port;       /* In network byte order. */
+	u8 protocol;
+	u8 operation;
+	bool is_ipv6;
+};
+
+/* Structure for remembering granted datagram peers of a socket. */
+struct ccs_socket_cache {
+	struct hlist_node list;
+	struct rcu_head rcu;
+	const struct inode *inode; /* Inode of the socket. */
+	seqlock_t lock;
+	u8 next; /* Index of "verdict" to overwrite next. */
+	struct ccs_socket_verdict verdict[CCS_SOCKET_CACHE_WAYS];
+};
+
+/* Structure for hash table of "struct ccs_socket_cache". */
+struct ccs_socket_cache_table {
+	struct rcu_head rcu;
+	/* Memory counted in ccs_memory_used[CCS_MEMORY_SOCKET]. 0 if static. */
+	unsigned int size;
+	u8 bits; /* @list has 1 << @bits elements. */
+	struct hlist_head *list;
 };
 
+#endif
+
+#ifdef CONFIG_CCSECURITY_MISC
+
+/* Structure for looking up "misc env" ACL entries by literal name. */
+struct ccs_env_index {
+	struct ccs_domain_index head;
+	/* Number of elements in "slot" minus 1. Power of 2 minus 1. */
+	unsigned int mask;
+	/* Open addressing hash table keyed by "struct ccs_path_info"->hash. */
+	const struct ccs_env_acl *slot[1];
+};
+
+#endif
+
 /***** SECTION3: Prototype definition section *****/
 
 bool ccs_dump_page(struct linux_binprm *bprm, unsigned long pos,
 		   struct ccs_page_dump *dump);
-void ccs_get_attributes(struct ccs_obj_info *obj);
+const struct ccs_bprm_strings *ccs_load_bprm(struct ccs_execve *ee);
+struct ccs_domain_index *ccs_build_domain_index
+(const struct ccs_domain_info *domain, const u8 type);
+struct ccs_domain_index *ccs_build_group_ranges(const struct ccs_group *group,
+						const u8 type);
+void ccs_get_attributes(struct ccs_obj_info *obj, const u8 mask);
 
 static bool ccs_alphabet_char(const char c);
 static bool ccs_argv(const unsigned int index, const char *arg_ptr,
@@ -212,6 +328,8 @@ static bool ccs_compare_number_union(const unsigned long value,
 				     const struct ccs_number_union *ptr);
 static bool ccs_condition(struct ccs_request_info *r,
 			  const struct ccs_condition *cond);
+static bool ccs_condition_value(struct ccs_condition_var *var, const u8 index,
+				unsigned long *value);
 static bool ccs_decimal(const char c);
 static bool ccs_envp(const char *env_name, const char *env_value,
 		     const int envc, const struct ccs_envp *envp, u8 *checked);
@@ -225,6 +343,15 @@ static bool ccs_file_matches_pattern2(const char *filename,
 				      const char *pattern_end);
 static bool ccs_get_realpath(struct ccs_path_info *buf, struct path *path);
 static bool ccs_hexadecimal(const char c);
+static bool ccs_match_acl(struct ccs_request_info *r,
+			  struct ccs_acl_info *ptr);
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+static bool ccs_match_table(struct ccs_request_info *r,
+			    const struct list_head *list,
+			    const struct ccs_acl_table *table,
+			    const unsigned int generation,
+			    struct ccs_acl_info **ptr);
+#endif
 static bool ccs_number_matches_group(const unsigned long min,
 				     const unsigned long max,
 				     const struct ccs_group *group);
@@ -243,6 +370,9 @@ static bool ccs_scan_transition(const struct list_head *list,
 				const char *last_name,
 				const enum ccs_transition_type type);
 static const char *ccs_last_word(const char *name);
+static const char *ccs_request_path(const struct ccs_request_info *r);
+static const struct ccs_group_ranges *ccs_get_group_ranges
+(const struct ccs_group *group);
 static const struct ccs_path_info *ccs_compare_name_union
 (const struct ccs_path_info *name, const struct ccs_name_union *ptr);
 static const struct ccs_path_info *ccs_path_matches_group
@@ -343,18 +473,46 @@ static
 #endif
 int ccs_path_permission(struct ccs_request_info *r, u8 operation,
 			const struct ccs_path_info *filename);
+static int ccs_number_range_cmp(const void *a, const void *b);
 static int ccs_symlink_path(const char *pathname, struct ccs_path_info *name);
+static const struct ccs_domain_index *ccs_get_domain_index
+(struct ccs_domain_info *domain, const u8 type);
+static struct ccs_acl_info *ccs_find_acl(struct ccs_request_info *r,
+					 struct ccs_domain_info *domain);
+static struct ccs_acl_info *ccs_find_indexed_acl
+(struct ccs_request_info *r, struct ccs_domain_info *domain);
+static struct ccs_acl_info *ccs_match_array(struct ccs_request_info *r,
+					    struct ccs_acl_info * const *acl,
+					    const u32 count);
+static struct ccs_group_ranges *ccs_build_number_ranges
+(const struct ccs_group *group);
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 32)
 static void __ccs_clear_open_mode(void);
 static void __ccs_save_open_mode(int mode);
 #endif
+static void *ccs_alloc_domain_index(size_t size);
 static void ccs_add_slash(struct ccs_path_info *buf);
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+static void ccs_count_hit(struct ccs_domain_info *domain,
+			  struct ccs_acl_info *ptr);
+#endif
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+static void ccs_count_acl(const struct ccs_acl_info *ptr, const bool cond,
+			  const bool matched, const cycles_t start);
+static void ccs_count_indexed(const struct ccs_acl_info *ptr);
+#endif
 
 #ifdef CONFIG_CCSECURITY_MISC
 static bool ccs_check_env_acl(struct ccs_request_info *r,
 			      const struct ccs_acl_info *ptr);
 static int ccs_env_perm(struct ccs_request_info *r, const char *env);
 static int ccs_environ(struct ccs_execve *ee);
+static const struct ccs_env_acl *ccs_find_env_slot
+(const struct ccs_env_index *index, const struct ccs_path_info *name);
+static struct ccs_env_index *ccs_build_env_index
+(const struct ccs_domain_info *domain);
+static unsigned int ccs_collect_env_acl(const struct ccs_domain_info *domain,
+					struct ccs_env_index *index);
 #endif
 
 #ifdef CONFIG_CCSECURITY_CAPABILITY
@@ -374,6 +532,15 @@ static bool ccs_check_inet_acl(struct ccs_request_info *r,
 static bool ccs_check_unix_acl(struct ccs_request_info *r,
 			       const struct ccs_acl_info *ptr);
 static bool ccs_kernel_service(void);
+static bool ccs_socket_cache_granted(const struct inode *inode,
+				     const struct ccs_socket_verdict *verdict);
+static bool ccs_socket_cache_key(const struct ccs_addr_info *address,
+				 const struct ccs_request_info *r,
+				 struct ccs_socket_verdict *verdict);
+static bool ccs_socket_cache_granted_fast(const struct ccs_addr_info *address,
+					  const u8 type);
+static const struct ccs_inet_acl *ccs_find_inet_range
+(const struct ccs_inet_index *index, const struct ccs_request_info *r);
 static int __ccs_socket_bind_permission(struct socket *sock,
 					struct sockaddr *addr, int addr_len);
 static int __ccs_socket_connect_permission(struct socket *sock,
@@ -391,8 +558,27 @@ static int ccs_check_unix_address(struct sockaddr *addr,
 				  const unsigned int addr_len,
 				  struct ccs_addr_info *address);
 static int ccs_inet_entry(const struct ccs_addr_info *address);
+static int ccs_address_range_cmp(const void *a, const void *b);
+static int ccs_inet_range_cmp(const void *a, const void *b);
 static int ccs_unix_entry(const struct ccs_addr_info *address);
+static struct ccs_group_ranges *ccs_build_address_ranges
+(const struct ccs_group *group);
+static struct ccs_inet_index *ccs_build_inet_index
+(const struct ccs_domain_info *domain);
+static struct ccs_socket_cache *ccs_find_socket_cache
+(const struct ccs_socket_cache_table *table, const struct inode *inode);
 static u8 ccs_sock_family(struct sock *sk);
+static void ccs_free_socket_cache(struct rcu_head *rcu);
+static void ccs_free_socket_cache_table(struct rcu_head *rcu);
+static void ccs_socket_cache_grant(const struct inode *inode,
+				   const struct ccs_socket_verdict *verdict);
+static void ccs_add_inet_range(struct ccs_inet_index *index,
+			       const struct ccs_inet_acl *acl,
+			       const struct ccs_ipaddr_union *address,
+			       const bool fill);
+static void ccs_collect_inet_range(const struct ccs_domain_info *domain,
+				   struct ccs_inet_index *index,
+				   const bool fill);
 #endif
 
 #ifdef CONFIG_CCSECURITY_NETWORK_RECVMSG
@@ -647,6 +833,32 @@ struct ccs_domain_info ccs_kernel_domain;
 /* The list for "struct ccs_domain_info". */
 LIST_HEAD(ccs_domain_list);
 
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+
+/* Per-CPU counter for sampling granted requests. */
+static DEFINE_PER_CPU(u8, ccs_hit_tick);
+
+#endif
+
+#ifdef CONFIG_CCSECURITY_NETWORK
+
+/* Initial list of "struct ccs_socket_cache", indexed by hash of inode. */
+static struct hlist_head ccs_socket_cache_list[CCS_MAX_SOCKET_CACHE_HASH];
+/* Initial hash table, which is never released. */
+static struct ccs_socket_cache_table ccs_socket_cache_initial = {
+	.bits = CCS_SOCKET_CACHE_HASH_BITS,
+	.list = ccs_socket_cache_list,
+};
+/* Current hash table of "struct ccs_socket_cache". */
+static struct ccs_socket_cache_table *ccs_socket_cache_table =
+	&ccs_socket_cache_initial;
+/* Number of "struct ccs_socket_cache" in ccs_socket_cache_table. */
+static unsigned int ccs_socket_cache_count;
+/* Lock for modifying ccs_socket_cache_table. */
+static DEFINE_SPINLOCK(ccs_socket_cache_lock);
+
+#endif
+
 /***** SECTION6: Dependent functions section *****/
 
 /**
@@ -666,7 +878,7 @@ static const struct ccs_path_info *ccs_path_matches_group
 	struct ccs_path_group *member;
 	list_for_each_entry_srcu(member, &group->member_list, head.list,
 				 &ccs_ss) {
-		if (member->head.is_deleted)
+		if (ccs_deleted(member->head.is_deleted))
 			continue;
 		if (!ccs_path_matches_pattern(pathname, member->member_name))
 			continue;
@@ -675,6 +887,125 @@ static const struct ccs_path_info *ccs_path_matches_group
 	return NULL;
 }
 
+/**
+ * ccs_build_group_ranges - Build sorted members of a group.
+ *
+ * @group: Pointer to "struct ccs_group".
+ * @type:  One of values in "enum ccs_group_id".
+ *
+ * Returns pointer to "struct ccs_domain_index" on success, NULL otherwise.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+struct ccs_domain_index *ccs_build_group_ranges(const struct ccs_group *group,
+						const u8 type)
+{
+	switch (type) {
+	case CCS_NUMBER_GROUP:
+		return (struct ccs_domain_index *)
+			ccs_build_number_ranges(group);
+#ifdef CONFIG_CCSECURITY_NETWORK
+	case CCS_ADDRESS_GROUP:
+		return (struct ccs_domain_index *)
+			ccs_build_address_ranges(group);
+#endif
+	}
+	return NULL;
+}
+
+/**
+ * ccs_get_group_ranges - Get up to date sorted members of a group.
+ *
+ * @group: Pointer to "struct ccs_group".
+ *
+ * Returns pointer to "struct ccs_group_ranges" on success, NULL otherwise.
+ *
+ * Missing or stale members are sorted by the garbage collector, so that
+ * callers never wait for ccs_policy_lock nor allocate memory, and loading
+ * many members one by one does not sort many times.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static const struct ccs_group_ranges *ccs_get_group_ranges
+(const struct ccs_group *group)
+{
+	struct ccs_group *g = (struct ccs_group *) group;
+	const struct ccs_domain_index *ranges =
+		srcu_dereference(g->ranges, &ccs_ss);
+	if (ranges && ranges->generation == ccs_acl_generation)
+		return (const struct ccs_group_ranges *) ranges;
+	/* Ask the garbage collector to rebuild sorted members. */
+	if (!g->ranges_pending) {
+		g->ranges_pending = true;
+		if (!test_and_set_bit(CCS_GC_DIRTY_RANGES, &ccs_gc_dirty))
+			ccs_schedule_gc();
+	}
+	return NULL;
+}
+
+/**
+ * ccs_number_range_cmp - Compare "struct ccs_number_range" by lower bound.
+ *
+ * @a: Pointer to "struct ccs_number_range".
+ * @b: Pointer to "struct ccs_number_range".
+ *
+ * Returns negative, zero or positive value like memcmp().
+ */
+static int ccs_number_range_cmp(const void *a, const void *b)
+{
+	const unsigned long x = ((const struct ccs_number_range *) a)->min;
+	const unsigned long y = ((const struct ccs_number_range *) b)->min;
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * ccs_build_number_ranges - Build sorted members of a number group.
+ *
+ * @group: Pointer to "struct ccs_group".
+ *
+ * Returns pointer to "struct ccs_group_ranges" on success, NULL otherwise.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static struct ccs_group_ranges *ccs_build_number_ranges
+(const struct ccs_group *group)
+{
+	struct ccs_group_ranges *ranges;
+	struct ccs_number_group *member;
+	struct ccs_number_range *range;
+	unsigned int count = 0;
+	unsigned int i;
+	list_for_each_entry(member, &group->member_list, head.list)
+		if (!ccs_deleted(member->head.is_deleted))
+			count++;
+	ranges = ccs_alloc_domain_index(sizeof(*ranges) +
+					count * sizeof(*range));
+	if (!ranges)
+		return NULL;
+	range = (struct ccs_number_range *) (ranges + 1);
+	ranges->number = range;
+	count = 0;
+	list_for_each_entry(member, &group->member_list, head.list) {
+		if (ccs_deleted(member->head.is_deleted))
+			continue;
+		range[count].min = member->number.values[0];
+		range[count].max = member->number.values[1];
+		count++;
+	}
+	sort(range, count, sizeof(*range), ccs_number_range_cmp, NULL);
+	/* Merge overlapping ranges. */
+	for (i = 0; i < count; i++) {
+		unsigned int *n = &ranges->count[0];
+		if (*n && range[i].min <= range[*n - 1].max) {
+			if (range[i].max > range[*n - 1].max)
+				range[*n - 1].max = range[i].max;
+			continue;
+		}
+		range[(*n)++] = range[i];
+	}
+	return ranges;
+}
+
 /**
  * ccs_number_matches_group - Check whether the given number matches members of the given number group.
  *
@@ -690,11 +1021,26 @@ static bool ccs_number_matches_group(const unsigned long min,
 				     const unsigned long max,
 				     const struct ccs_group *group)
 {
+	const struct ccs_group_ranges *ranges = ccs_get_group_ranges(group);
 	struct ccs_number_group *member;
 	bool matched = false;
+	if (ranges) {
+		const struct ccs_number_range *range = ranges->number;
+		unsigned int lo = 0;
+		unsigned int hi = ranges->count[0];
+		/* Find the first range which does not end before @min. */
+		while (lo < hi) {
+			const unsigned int mid = lo + (hi - lo) / 2;
+			if (range[mid].max < min)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo < ranges->count[0] && range[lo].min <= max;
+	}
 	list_for_each_entry_srcu(member, &group->member_list, head.list,
 				 &ccs_ss) {
-		if (member->head.is_deleted)
+		if (ccs_deleted(member->head.is_deleted))
 			continue;
 		if (min > member->number.values[1] ||
 		    max < member->number.values[0])
@@ -718,7 +1064,7 @@ static bool ccs_number_matches_group(const unsigned long min,
 static bool ccs_check_entry(struct ccs_request_info *r,
 			    struct ccs_acl_info *ptr)
 {
-	if (ptr->is_deleted || ptr->type != r->param_type)
+	if (ccs_deleted(ptr->is_deleted) || ptr->type != r->param_type)
 		return false;
 	switch (r->param_type) {
 	case CCS_TYPE_PATH_ACL:
@@ -757,6 +1103,390 @@ static bool ccs_check_entry(struct ccs_request_info *r,
 	return true;
 }
 
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+
+/**
+ * ccs_count_hit - Count a request granted by an ACL entry.
+ *
+ * @domain: Pointer to "struct ccs_domain_info" which requested.
+ * @ptr:    Pointer to "struct ccs_acl_info".
+ *
+ * Returns nothing.
+ *
+ * Only one out of CCS_HOT_ACL_SAMPLE requests on each CPU is counted, on a
+ * per-CPU counter of @ptr so that CPUs do not bounce the entry's cache line.
+ * Only @domain is rebuilt by the garbage collector, at most once per
+ * CCS_HOT_ACL_INTERVAL.
+ */
+static void ccs_count_hit(struct ccs_domain_info *domain,
+			  struct ccs_acl_info *ptr)
+{
+	/* Not 0, for jiffies starts from a value just before wrapping. */
+	static unsigned long ccs_hot_acl_next = INITIAL_JIFFIES;
+	u8 *tick = &get_cpu_var(ccs_hit_tick);
+	const bool sample = !(++*tick & (CCS_HOT_ACL_SAMPLE - 1));
+	if (sample && ptr->hits)
+		(*per_cpu_ptr(ptr->hits, smp_processor_id()))++;
+	put_cpu_var(ccs_hit_tick);
+	if (!sample)
+		return;
+	if (!domain->hot_pending)
+		domain->hot_pending = true;
+	if (time_before(jiffies, ACCESS_ONCE(ccs_hot_acl_next)))
+		return;
+	ccs_hot_acl_next = jiffies + CCS_HOT_ACL_INTERVAL;
+	if (!test_and_set_bit(CCS_GC_DIRTY_HOT, &ccs_gc_dirty))
+		ccs_schedule_gc();
+}
+
+#endif
+
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+
+/**
+ * ccs_count_acl - Update "struct ccs_acl_counter" of current CPU.
+ *
+ * @ptr:     Pointer to "struct ccs_acl_info".
+ * @cond:    True if the condition part was evaluated, false otherwise.
+ * @matched: True if the evaluation matched, false otherwise.
+ * @start:   Value of get_cycles() before the evaluation.
+ *
+ * Returns nothing.
+ *
+ * Counters are 64 bits wide so that they practically never wrap around, and
+ * are updated with preemption disabled so that no update is lost.
+ */
+static void ccs_count_acl(const struct ccs_acl_info *ptr, const bool cond,
+			  const bool matched, const cycles_t start)
+{
+	const cycles_t end = get_cycles();
+	struct ccs_acl_counter *counter;
+	struct ccs_eval_counter *step;
+	if (!ptr->profile)
+		return;
+	counter = per_cpu_ptr(ptr->profile, get_cpu());
+	step = cond ? &counter->cond : &counter->entry;
+	step->evaluated++;
+	if (matched)
+		step->matched++;
+	step->cycles += end - start;
+	put_cpu();
+}
+
+/**
+ * ccs_count_indexed - Count a match found without evaluating the lists.
+ *
+ * @ptr: Pointer to "struct ccs_acl_info".
+ *
+ * Returns nothing.
+ */
+static void ccs_count_indexed(const struct ccs_acl_info *ptr)
+{
+	if (!ccs_acl_profiling || !ptr->profile)
+		return;
+	per_cpu_ptr(ptr->profile, get_cpu())->indexed++;
+	put_cpu();
+}
+
+#endif
+
+/**
+ * ccs_match_acl - Check whether an ACL entry grants a request.
+ *
+ * @r:   Pointer to "struct ccs_request_info".
+ * @ptr: Pointer to "struct ccs_acl_info".
+ *
+ * Returns true if @ptr grants @r, false otherwise.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static bool ccs_match_acl(struct ccs_request_info *r,
+			  struct ccs_acl_info *ptr)
+{
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+	if (ccs_acl_profiling) {
+		cycles_t start = get_cycles();
+		bool matched = ccs_check_entry(r, ptr);
+		ccs_count_acl(ptr, false, matched, start);
+		if (!matched || !ptr->cond)
+			return matched;
+		start = get_cycles();
+		matched = ccs_condition(r, ptr->cond);
+		ccs_count_acl(ptr, true, matched, start);
+		return matched;
+	}
+#endif
+	return ccs_check_entry(r, ptr) && ccs_condition(r, ptr->cond);
+}
+
+/**
+ * ccs_match_array - Find an ACL entry which grants a request from an array.
+ *
+ * @r:     Pointer to "struct ccs_request_info".
+ * @acl:   Pointer to an array of pointers to "struct ccs_acl_info".
+ * @count: Number of elements in @acl.
+ *
+ * Returns pointer to "struct ccs_acl_info" if found, NULL otherwise.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static struct ccs_acl_info *ccs_match_array(struct ccs_request_info *r,
+					    struct ccs_acl_info * const *acl,
+					    const u32 count)
+{
+	u32 i;
+	for (i = 0; i < count; i++)
+		if (ccs_match_acl(r, acl[i]))
+			return acl[i];
+	return NULL;
+}
+
+/**
+ * ccs_alloc_domain_index - Allocate memory for "struct ccs_domain_index".
+ *
+ * @size: Size in bytes, including "struct ccs_domain_index".
+ *
+ * Returns pointer to zeroed memory on success, NULL otherwise.
+ *
+ * The memory is charged to the policy memory quota, and its header is filled
+ * with current ccs_acl_generation.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void *ccs_alloc_domain_index(size_t size)
+{
+	struct ccs_domain_index *index;
+	size = ccs_round2(size);
+	if (ccs_memory_quota[CCS_MEMORY_POLICY] &&
+	    ccs_memory_used[CCS_MEMORY_POLICY] + size >
+	    ccs_memory_quota[CCS_MEMORY_POLICY])
+		return NULL;
+	index = kzalloc(size, CCS_GFP_FLAGS | __GFP_NOWARN);
+	if (!index)
+		return NULL;
+	ccs_memory_used[CCS_MEMORY_POLICY] += size;
+	index->generation = ccs_acl_generation;
+	index->size = size;
+	return index;
+}
+
+/**
+ * ccs_build_domain_index - Build an index of ACL entries of a domain.
+ *
+ * @domain: Pointer to "struct ccs_domain_info".
+ * @type:   One of values in "enum ccs_domain_index_type".
+ *
+ * Returns pointer to "struct ccs_domain_index" on success, NULL otherwise.
+ *
+ * Only entries without conditions which are neither deleted nor in
+ * uncommitted transactions are indexed. Others are left to ccs_find_acl().
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+struct ccs_domain_index *ccs_build_domain_index
+(const struct ccs_domain_info *domain, const u8 type)
+{
+	switch (type) {
+#ifdef CONFIG_CCSECURITY_NETWORK
+	case CCS_INDEX_INET:
+		return (struct ccs_domain_index *)
+			ccs_build_inet_index(domain);
+#endif
+#ifdef CONFIG_CCSECURITY_MISC
+	case CCS_INDEX_ENV:
+		return (struct ccs_domain_index *) ccs_build_env_index(domain);
+#endif
+	}
+	return NULL;
+}
+
+/**
+ * ccs_get_domain_index - Get an up to date index of ACL entries of a domain.
+ *
+ * @domain: Pointer to "struct ccs_domain_info".
+ * @type:   One of values in "enum ccs_domain_index_type".
+ *
+ * Returns pointer to "struct ccs_domain_index" on success, NULL otherwise.
+ *
+ * A missing or stale index is rebuilt by the garbage collector, so that
+ * callers never wait for ccs_policy_lock.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static const struct ccs_domain_index *ccs_get_domain_index
+(struct ccs_domain_info *domain, const u8 type)
+{
+	const struct ccs_domain_index *index =
+		srcu_dereference(domain->index[type], &ccs_ss);
+	if (index && index->generation == ccs_acl_generation)
+		return index;
+	/* Ask the garbage collector to rebuild this index. */
+	if (!test_bit(type, &domain->index_pending) &&
+	    !test_and_set_bit(type, &domain->index_pending) &&
+	    !test_and_set_bit(CCS_GC_DIRTY_INDEX, &ccs_gc_dirty))
+		ccs_schedule_gc();
+	return NULL;
+}
+
+/**
+ * ccs_find_indexed_acl - Find an ACL entry which grants a request using indexes.
+ *
+ * @r:      Pointer to "struct ccs_request_info".
+ * @domain: Pointer to "struct ccs_domain_info".
+ *
+ * Returns pointer to "struct ccs_acl_info" if found, NULL otherwise.
+ *
+ * If this function returns NULL, the caller needs to check the lists because
+ * entries with conditions are not indexed.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static struct ccs_acl_info *ccs_find_indexed_acl
+(struct ccs_request_info *r, struct ccs_domain_info *domain)
+{
+	const struct ccs_domain_index *index;
+	switch (r->param_type) {
+#ifdef CONFIG_CCSECURITY_NETWORK
+	case CCS_TYPE_INET_ACL: {
+		const struct ccs_inet_acl *acl;
+		index = ccs_get_domain_index(domain, CCS_INDEX_INET);
+		if (!index)
+			break;
+		acl = ccs_find_inet_range(container_of(index, struct
+						       ccs_inet_index, head),
+					  r);
+		if (acl)
+			return (struct ccs_acl_info *) &acl->head;
+		break;
+	}
+#endif
+#ifdef CONFIG_CCSECURITY_MISC
+	case CCS_TYPE_ENV_ACL: {
+		const struct ccs_env_acl *acl;
+		index = ccs_get_domain_index(domain, CCS_INDEX_ENV);
+		if (!index)
+			break;
+		acl = ccs_find_env_slot(container_of(index, struct
+						     ccs_env_index, head),
+					r->param.environ.name);
+		if (acl)
+			return (struct ccs_acl_info *) &acl->head;
+		break;
+	}
+#endif
+	}
+	return NULL;
+}
+
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+
+/**
+ * ccs_match_table - Find an ACL entry which grants a request using "struct ccs_acl_table".
+ *
+ * @r:          Pointer to "struct ccs_request_info".
+ * @list:       Pointer to "struct list_head" which @table was built from.
+ * @table:      Pointer to "struct ccs_acl_table". Maybe NULL.
+ * @generation: Current "acl_generation" of @list.
+ * @ptr:        Pointer to "struct ccs_acl_info *". Set to the matched entry
+ *              or NULL if this function returned true.
+ *
+ * Returns true if @table is up to date, false if the caller has to walk
+ * @list.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static bool ccs_match_table(struct ccs_request_info *r,
+			    const struct list_head *list,
+			    const struct ccs_acl_table *table,
+			    const unsigned int generation,
+			    struct ccs_acl_info **ptr)
+{
+	const u8 type = r->param_type;
+	if (table && table->generation == generation) {
+		*ptr = ccs_match_array(r, table->acl + table->start[type],
+				       table->start[type + 1] -
+				       table->start[type]);
+		return true;
+	}
+	/* Ask the garbage collector to compile this list. */
+	if ((table || !list_empty(list)) &&
+	    !test_bit(CCS_GC_DIRTY_TABLE, &ccs_gc_dirty) &&
+	    !test_and_set_bit(CCS_GC_DIRTY_TABLE, &ccs_gc_dirty))
+		ccs_schedule_gc();
+	return false;
+}
+
+#endif
+
+/**
+ * ccs_find_acl - Find an ACL entry which grants a request.
+ *
+ * @r:      Pointer to "struct ccs_request_info".
+ * @domain: Pointer to "struct ccs_domain_info".
+ *
+ * Returns pointer to "struct ccs_acl_info" if found, NULL otherwise.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static struct ccs_acl_info *ccs_find_acl(struct ccs_request_info *r,
+					 struct ccs_domain_info *domain)
+{
+	const struct list_head *list = &domain->acl_info_list;
+	struct ccs_acl_info *ptr;
+	u16 i = 0;
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+	const struct ccs_acl_table *table =
+		srcu_dereference(domain->acl_table, &ccs_ss);
+	unsigned int generation = domain->acl_generation;
+#endif
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+	const struct ccs_hot_acl *hot = srcu_dereference(domain->hot_acl,
+							 &ccs_ss);
+#endif
+	ptr = ccs_find_indexed_acl(r, domain);
+	if (ptr) {
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+		ccs_count_indexed(ptr);
+#endif
+		return ptr;
+	}
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+	if (hot && hot->generation == ccs_acl_generation) {
+		ptr = ccs_match_array(r, hot->acl, hot->count);
+		if (ptr)
+			return ptr;
+	}
+#endif
+retry:
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+	if (ccs_match_table(r, list, table, generation, &ptr)) {
+		if (ptr)
+			return ptr;
+		goto next;
+	}
+#endif
+	list_for_each_entry_srcu(ptr, list, list, &ccs_ss) {
+		if (ccs_match_acl(r, ptr))
+			return ptr;
+	}
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+next:
+#endif
+	for (; i < CCS_MAX_ACL_GROUPS; i++) {
+		if (!test_bit(i, domain->group))
+			continue;
+		list = &domain->ns->acl_group[i];
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+		table = srcu_dereference(domain->ns->acl_group_table[i],
+					 &ccs_ss);
+		generation = domain->ns->acl_group_generation[i];
+#endif
+		i++;
+		goto retry;
+	}
+	return NULL;
+}
+
 /**
  * ccs_check_acl - Do permission check.
  *
@@ -768,36 +1498,86 @@ static bool ccs_check_entry(struct ccs_request_info *r,
  */
 int ccs_check_acl(struct ccs_request_info *r)
 {
-	const struct ccs_domain_info *domain = ccs_current_domain();
+	struct ccs_domain_info *domain = ccs_current_domain();
+	const u64 trace_start = trace_ccs_permission_enabled() ?
+		ccs_trace_clock() : 0;
 	int error;
+	ccs_add_stat(acl_check[r->type], 1);
 	do {
-		struct ccs_acl_info *ptr;
-		const struct list_head *list = &domain->acl_info_list;
-		u16 i = 0;
-retry:
-		list_for_each_entry_srcu(ptr, list, list, &ccs_ss) {
-			if (!ccs_check_entry(r, ptr))
-				continue;
-			if (!ccs_condition(r, ptr->cond))
-				continue;
+		const u64 start = ccs_latency_start();
+		struct ccs_acl_info *ptr = ccs_find_acl(r, domain);
+		ccs_latency_end(CCS_LATENCY_ACL, start);
+		if (ptr) {
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+			ccs_count_hit(domain, ptr);
+#endif
 			r->matched_acl = ptr;
 			r->granted = true;
-			ccs_audit_log(r);
+			ccs_latency(CCS_LATENCY_AUDIT, ccs_audit_log(r));
+			if (trace_ccs_permission_enabled())
+				trace_ccs_permission
+					(r->type, domain,
+					 domain->domainname->name,
+					 ccs_request_path(r), true, 0,
+					 ccs_trace_clock() - trace_start);
 			return 0;
 		}
-		for (; i < CCS_MAX_ACL_GROUPS; i++) {
-			if (!test_bit(i, domain->group))
-				continue;
-			list = &domain->ns->acl_group[i++];
-			goto retry;
-		}
 		r->granted = false;
-		error = ccs_audit_log(r);
+		error = ccs_latency(CCS_LATENCY_AUDIT, ccs_audit_log(r));
 	} while (error == CCS_RETRY_REQUEST &&
 		 r->type != CCS_MAC_FILE_EXECUTE);
+	if (trace_ccs_permission_enabled())
+		trace_ccs_permission(r->type, domain, domain->domainname->name,
+				     ccs_request_path(r), false, error,
+				     ccs_trace_clock() - trace_start);
 	return error;
 }
 
+/**
+ * ccs_request_path - Get pathname of a request for tracing.
+ *
+ * @r: Pointer to "struct ccs_request_info".
+ *
+ * Returns the first pathname in @r->param if any, "" otherwise.
+ */
+static const char *ccs_request_path(const struct ccs_request_info *r)
+{
+	const struct ccs_path_info *name = NULL;
+	switch (r->param_type) {
+	case CCS_TYPE_PATH_ACL:
+		name = r->param.path.filename;
+		break;
+	case CCS_TYPE_PATH2_ACL:
+		name = r->param.path2.filename1;
+		break;
+	case CCS_TYPE_PATH_NUMBER_ACL:
+		name = r->param.path_number.filename;
+		break;
+	case CCS_TYPE_MKDEV_ACL:
+		name = r->param.mkdev.filename;
+		break;
+	case CCS_TYPE_MOUNT_ACL:
+		name = r->param.mount.dir;
+		break;
+#ifdef CONFIG_CCSECURITY_MISC
+	case CCS_TYPE_ENV_ACL:
+		name = r->param.environ.name;
+		break;
+#endif
+#ifdef CONFIG_CCSECURITY_NETWORK
+	case CCS_TYPE_UNIX_ACL:
+		name = r->param.unix_network.address;
+		break;
+#endif
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+	case CCS_TYPE_MANUAL_TASK_ACL:
+		name = r->param.task.domainname;
+		break;
+#endif
+	}
+	return name ? name->name : "";
+}
+
 /**
  * ccs_last_word - Get last component of a domainname.
  *
@@ -834,7 +1614,7 @@ static bool ccs_scan_transition(const struct list_head *list,
 {
 	const struct ccs_transition_control *ptr;
 	list_for_each_entry_srcu(ptr, list, head.list, &ccs_ss) {
-		if (ptr->head.is_deleted || ptr->type != type)
+		if (ccs_deleted(ptr->head.is_deleted) || ptr->type != type)
 			continue;
 		if (ptr->domainname) {
 			if (!ptr->is_last_name) {
@@ -920,6 +1700,8 @@ static int ccs_find_next_domain(struct ccs_execve *ee)
 	struct ccs_security *task = ccs_current_security();
 	const struct ccs_path_info *candidate;
 	struct ccs_path_info exename;
+	const u64 trace_start = trace_ccs_domain_transition_enabled() ?
+		ccs_trace_clock() : 0;
 	int retval;
 	bool reject_on_transition_failure = false;
 
@@ -952,7 +1734,7 @@ retry:
 		candidate = &exename;
 		list = &old_domain->ns->policy_list[CCS_ID_AGGREGATOR];
 		list_for_each_entry_srcu(ptr, list, head.list, &ccs_ss) {
-			if (ptr->head.is_deleted ||
+			if (ccs_deleted(ptr->head.is_deleted) ||
 			    !ccs_path_matches_pattern(candidate,
 						      ptr->original_name))
 				continue;
@@ -1090,6 +1872,11 @@ force_jump_domain:
 		}
 	}
 out:
+	if (trace_ccs_domain_transition_enabled())
+		trace_ccs_domain_transition
+			(old_domain, old_domain->domainname->name, domain,
+			 domain ? domain->domainname->name : "", exename.name,
+			 retval, ccs_trace_clock() - trace_start);
 	kfree(exename.name);
 	return retval;
 }
@@ -1191,13 +1978,14 @@ static int ccs_try_alt_exec(struct ccs_execve *ee)
 	ee->obj.path1.mnt = NULL;
 	ee->obj.stat_valid[CCS_PATH1] = false;
 	ee->obj.stat_valid[CCS_PATH1_PARENT] = false;
-	ee->obj.validate_done = false;
+	ee->obj.stat_fetched &= ~((1 << CCS_PATH1) | (1 << CCS_PATH1_PARENT));
 	allow_write_access(bprm->file);
 	fput(bprm->file);
 	bprm->file = NULL;
 
-	/* Invalidate page dump cache. */
-	ee->dump.page = NULL;
+	/* Invalidate argv[] and envp[] cache. */
+	vfree(ee->strings.data);
+	ee->strings.data = NULL;
 
 	/* Move envp[] to argv[] */
 	bprm->argc += bprm->envc;
@@ -1421,7 +2209,7 @@ bool ccs_dump_page(struct linux_binprm *bprm, unsigned long pos,
 		   struct ccs_page_dump *dump)
 {
 	struct page *page;
-	/* dump->data is released by ccs_start_execve(). */
+	/* dump->data is released by ccs_load_bprm(). */
 	if (!dump->data) {
 		dump->data = kzalloc(PAGE_SIZE, CCS_GFP_FLAGS);
 		if (!dump->data)
@@ -1476,6 +2264,66 @@ bool ccs_dump_page(struct linux_binprm *bprm, unsigned long pos,
 	return true;
 }
 
+/**
+ * ccs_load_bprm - Copy argv[] and envp[] of "struct linux_binprm".
+ *
+ * @ee: Pointer to "struct ccs_execve".
+ *
+ * Returns pointer to "struct ccs_bprm_strings" on success, NULL otherwise.
+ *
+ * The pages holding argv[] and envp[] are walked only once per execve()
+ * request. Conditions, "misc env" checks and audit logs read the copy.
+ *
+ * The buffer is allocated once with the size of the area between bprm->p and
+ * the end of the argument pages, which execve() already limited.
+ */
+const struct ccs_bprm_strings *ccs_load_bprm(struct ccs_execve *ee)
+{
+	struct ccs_bprm_strings *strings = &ee->strings;
+	struct linux_binprm *bprm = ee->bprm;
+	/* dump.data is allocated by ccs_dump_page(). */
+	struct ccs_page_dump dump = { };
+	unsigned long pos = bprm->p;
+	int offset = pos % PAGE_SIZE;
+	int count = bprm->argc + bprm->envc;
+#ifdef CCS_BPRM_MMU
+	const size_t size = bprm->vma->vm_end - bprm->p;
+#else
+	const size_t size = MAX_ARG_PAGES * PAGE_SIZE - bprm->p;
+#endif
+	size_t len = 0;
+	char *data;
+	if (strings->data)
+		return strings;
+	data = vmalloc(size);
+	if (!data)
+		return NULL;
+	while (count) {
+		int end = offset;
+		size_t chunk;
+		if (!ccs_dump_page(bprm, pos, &dump))
+			goto out;
+		pos += PAGE_SIZE - offset;
+		while (count && end < PAGE_SIZE) {
+			if (!dump.data[end++])
+				count--;
+		}
+		chunk = end - offset;
+		if (size - len < chunk)
+			goto out;
+		memcpy(data + len, dump.data + offset, chunk);
+		len += chunk;
+		offset = 0;
+	}
+	strings->data = data;
+	strings->len = len;
+	data = NULL;
+out:
+	vfree(data);
+	kfree(dump.data);
+	return strings->data ? strings : NULL;
+}
+
 /**
  * ccs_start_execve - Prepare for execve() operation.
  *
@@ -1501,8 +2349,9 @@ int ccs_start_execve(struct linux_binprm *bprm, struct ccs_execve **eep)
 	}
 	ccs_audit_alloc_execve(ee);
 	idx = ccs_read_lock();
-	/* ee->dump->data is allocated by ccs_dump_page(). */
+	/* ee->strings.data is allocated by ccs_load_bprm(). */
 	ee->previous_domain = task->ccs_domain_info;
+	ccs_get_domain(ee->previous_domain);
 	/* Clear manager flag. */
 	task->ccs_flags &= ~CCS_TASK_IS_MANAGER;
 	*eep = ee;
@@ -1544,8 +2393,8 @@ done:
 	ccs_read_unlock(idx);
 	kfree(ee->tmp);
 	ee->tmp = NULL;
-	kfree(ee->dump.data);
-	ee->dump.data = NULL;
+	vfree(ee->strings.data);
+	ee->strings.data = NULL;
 	return retval;
 }
 
@@ -1563,7 +2412,7 @@ void ccs_finish_execve(int retval, struct ccs_execve *ee)
 	if (!ee)
 		return;
 	if (retval < 0) {
-		task->ccs_domain_info = ee->previous_domain;
+		ccs_set_domain(task, ee->previous_domain);
 		/*
 		 * Make task->ccs_domain_info visible to GC before changing
 		 * task->ccs_flags.
@@ -1580,6 +2429,7 @@ void ccs_finish_execve(int retval, struct ccs_execve *ee)
 	/* Tell GC that I finished execve(). */
 	task->ccs_flags &= ~CCS_TASK_IS_IN_EXECVE;
 	ccs_audit_free_execve(ee, true);
+	ccs_put_domain(ee->previous_domain);
 	kfree(ee->handler_path);
 	kfree(ee);
 }
@@ -3110,6 +3960,79 @@ static int ccs_old_chroot_permission(struct nameidata *nd)
 
 #ifdef CONFIG_CCSECURITY_NETWORK
 
+/**
+ * ccs_address_range_cmp - Compare "struct ccs_address_range" by lower bound.
+ *
+ * @a: Pointer to "struct ccs_address_range".
+ * @b: Pointer to "struct ccs_address_range".
+ *
+ * Returns negative, zero or positive value like memcmp().
+ */
+static int ccs_address_range_cmp(const void *a, const void *b)
+{
+	return memcmp(((const struct ccs_address_range *) a)->min,
+		      ((const struct ccs_address_range *) b)->min, 16);
+}
+
+/**
+ * ccs_build_address_ranges - Build sorted members of an address group.
+ *
+ * @group: Pointer to "struct ccs_group".
+ *
+ * Returns pointer to "struct ccs_group_ranges" on success, NULL otherwise.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static struct ccs_group_ranges *ccs_build_address_ranges
+(const struct ccs_group *group)
+{
+	struct ccs_group_ranges *ranges;
+	struct ccs_address_group *member;
+	unsigned int count[2] = { 0, 0 };
+	u8 is_ipv6;
+	list_for_each_entry(member, &group->member_list, head.list)
+		if (!ccs_deleted(member->head.is_deleted))
+			count[member->address.is_ipv6]++;
+	ranges = ccs_alloc_domain_index(sizeof(*ranges) +
+					(count[0] + count[1]) *
+					sizeof(struct ccs_address_range));
+	if (!ranges)
+		return NULL;
+	ranges->address[0] = (struct ccs_address_range *) (ranges + 1);
+	ranges->address[1] = ranges->address[0] + count[0];
+	list_for_each_entry(member, &group->member_list, head.list) {
+		struct ccs_address_range *range;
+		const bool v6 = member->address.is_ipv6;
+		if (ccs_deleted(member->head.is_deleted))
+			continue;
+		range = &ranges->address[v6][ranges->count[v6]++];
+		memcpy(range->min, &member->address.ip[0], v6 ? 16 : 4);
+		memcpy(range->max, &member->address.ip[1], v6 ? 16 : 4);
+	}
+	for (is_ipv6 = 0; is_ipv6 < 2; is_ipv6++) {
+		struct ccs_address_range *range = ranges->address[is_ipv6];
+		const unsigned int n = ranges->count[is_ipv6];
+		unsigned int *merged = &ranges->count[is_ipv6];
+		unsigned int i;
+		sort(range, n, sizeof(*range), ccs_address_range_cmp, NULL);
+		/* Merge overlapping ranges. */
+		*merged = 0;
+		for (i = 0; i < n; i++) {
+			if (*merged &&
+			    memcmp(range[i].min, range[*merged - 1].max, 16)
+			    <= 0) {
+				if (memcmp(range[i].max,
+					   range[*merged - 1].max, 16) > 0)
+					memcpy(range[*merged - 1].max,
+					       range[i].max, 16);
+				continue;
+			}
+			range[(*merged)++] = range[i];
+		}
+	}
+	return ranges;
+}
+
 /**
  * ccs_address_matches_group - Check whether the given address matches members of the given address group.
  *
@@ -3124,12 +4047,31 @@ static int ccs_old_chroot_permission(struct nameidata *nd)
 static bool ccs_address_matches_group(const bool is_ipv6, const u32 *address,
 				      const struct ccs_group *group)
 {
+	const struct ccs_group_ranges *ranges = ccs_get_group_ranges(group);
 	struct ccs_address_group *member;
 	bool matched = false;
 	const u8 size = is_ipv6 ? 16 : 4;
+	if (ranges) {
+		const struct ccs_address_range *range =
+			ranges->address[is_ipv6];
+		unsigned int lo = 0;
+		unsigned int hi = ranges->count[is_ipv6];
+		u8 addr[16] = { };
+		memcpy(addr, address, size);
+		/* Find the first range which does not end before @address. */
+		while (lo < hi) {
+			const unsigned int mid = lo + (hi - lo) / 2;
+			if (memcmp(range[mid].max, addr, 16) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo < ranges->count[is_ipv6] &&
+			memcmp(range[lo].min, addr, 16) <= 0;
+	}
 	list_for_each_entry_srcu(member, &group->member_list, head.list,
 				 &ccs_ss) {
-		if (member->head.is_deleted)
+		if (ccs_deleted(member->head.is_deleted))
 			continue;
 		if (member->address.is_ipv6 != is_ipv6)
 			continue;
@@ -3170,20 +4112,545 @@ static bool ccs_check_inet_acl(struct ccs_request_info *r,
 }
 
 /**
- * ccs_check_unix_acl - Check permission for unix domain socket operation.
+ * ccs_check_unix_acl - Check permission for unix domain socket operation.
+ *
+ * @r:   Pointer to "struct ccs_request_info".
+ * @ptr: Pointer to "struct ccs_acl_info".
+ *
+ * Returns true if granted, false otherwise.
+ */
+static bool ccs_check_unix_acl(struct ccs_request_info *r,
+			       const struct ccs_acl_info *ptr)
+{
+	const struct ccs_unix_acl *acl = container_of(ptr, typeof(*acl), head);
+	return (ptr->perm & (1 << r->param.unix_network.operation)) &&
+		ccs_compare_name_union(r->param.unix_network.address,
+				       &acl->name);
+}
+
+/**
+ * ccs_add_inet_range - Add an address range to "struct ccs_inet_index".
+ *
+ * @index:   Pointer to "struct ccs_inet_index".
+ * @acl:     Pointer to "struct ccs_inet_acl".
+ * @address: Pointer to "struct ccs_ipaddr_union". Never a group.
+ * @fill:    False to count elements, true to store elements.
+ *
+ * Returns nothing.
+ */
+static void ccs_add_inet_range(struct ccs_inet_index *index,
+			       const struct ccs_inet_acl *acl,
+			       const struct ccs_ipaddr_union *address,
+			       const bool fill)
+{
+	const bool is_ipv6 = address->is_ipv6;
+	const u8 size = is_ipv6 ? 16 : 4;
+	u8 operation;
+	for (operation = 0; operation < CCS_MAX_NETWORK_OPERATION;
+	     operation++) {
+		struct ccs_inet_range *range;
+		if (!(acl->head.perm & (1 << operation)))
+			continue;
+		if (!fill) {
+			index->count[operation][is_ipv6]++;
+			continue;
+		}
+		range = &index->range[operation][is_ipv6]
+			[index->count[operation][is_ipv6]++];
+		memcpy(range->min, &address->ip[0], size);
+		memcpy(range->max, &address->ip[1], size);
+		range->acl = acl;
+	}
+}
+
+/**
+ * ccs_collect_inet_range - Visit inet ACL entries without conditions.
+ *
+ * @domain: Pointer to "struct ccs_domain_info".
+ * @index:  Pointer to "struct ccs_inet_index".
+ * @fill:   False to count elements, true to store elements.
+ *
+ * Returns nothing.
+ *
+ * Address groups are flattened into their members.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_collect_inet_range(const struct ccs_domain_info *domain,
+				   struct ccs_inet_index *index,
+				   const bool fill)
+{
+	const struct list_head *list = &domain->acl_info_list;
+	struct ccs_acl_info *ptr;
+	u16 i = 0;
+retry:
+	list_for_each_entry(ptr, list, list) {
+		const struct ccs_inet_acl *acl;
+		struct ccs_address_group *member;
+		if (ptr->is_deleted || ptr->type != CCS_TYPE_INET_ACL ||
+		    ptr->cond)
+			continue;
+		acl = container_of(ptr, typeof(*acl), head);
+		if (!acl->address.group) {
+			ccs_add_inet_range(index, acl, &acl->address, fill);
+			continue;
+		}
+		list_for_each_entry(member, &acl->address.group->member_list,
+				    head.list) {
+			if (member->head.is_deleted)
+				continue;
+			ccs_add_inet_range(index, acl, &member->address, fill);
+		}
+	}
+	for (; i < CCS_MAX_ACL_GROUPS; i++) {
+		if (!test_bit(i, domain->group))
+			continue;
+		list = &domain->ns->acl_group[i++];
+		goto retry;
+	}
+}
+
+/**
+ * ccs_inet_range_cmp - Compare "struct ccs_inet_range" by lower bound.
+ *
+ * @a: Pointer to "struct ccs_inet_range".
+ * @b: Pointer to "struct ccs_inet_range".
+ *
+ * Returns negative, zero or positive value like memcmp().
+ */
+static int ccs_inet_range_cmp(const void *a, const void *b)
+{
+	return memcmp(((const struct ccs_inet_range *) a)->min,
+		      ((const struct ccs_inet_range *) b)->min, 16);
+}
+
+/**
+ * ccs_build_inet_index - Build "struct ccs_inet_index" for a domain.
+ *
+ * @domain: Pointer to "struct ccs_domain_info".
+ *
+ * Returns pointer to "struct ccs_inet_index" on success, NULL otherwise.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static struct ccs_inet_index *ccs_build_inet_index
+(const struct ccs_domain_info *domain)
+{
+	struct ccs_inet_index tmp = { };
+	struct ccs_inet_index *index;
+	struct ccs_inet_range *range;
+	unsigned int total = 0;
+	u8 operation;
+	u8 is_ipv6;
+	ccs_collect_inet_range(domain, &tmp, false);
+	for (operation = 0; operation < CCS_MAX_NETWORK_OPERATION;
+	     operation++)
+		for (is_ipv6 = 0; is_ipv6 < 2; is_ipv6++)
+			total += tmp.count[operation][is_ipv6];
+	index = ccs_alloc_domain_index(sizeof(*index) +
+				       total * sizeof(*range));
+	if (!index)
+		return NULL;
+	range = (struct ccs_inet_range *) (index + 1);
+	for (operation = 0; operation < CCS_MAX_NETWORK_OPERATION;
+	     operation++)
+		for (is_ipv6 = 0; is_ipv6 < 2; is_ipv6++) {
+			index->range[operation][is_ipv6] = range;
+			range += tmp.count[operation][is_ipv6];
+		}
+	ccs_collect_inet_range(domain, index, true);
+	for (operation = 0; operation < CCS_MAX_NETWORK_OPERATION;
+	     operation++)
+		for (is_ipv6 = 0; is_ipv6 < 2; is_ipv6++) {
+			const unsigned int count =
+				index->count[operation][is_ipv6];
+			const u8 *max_so_far = NULL;
+			unsigned int i;
+			range = index->range[operation][is_ipv6];
+			sort(range, count, sizeof(*range), ccs_inet_range_cmp,
+			     NULL);
+			for (i = 0; i < count; i++) {
+				if (!max_so_far ||
+				    memcmp(range[i].max, max_so_far, 16) > 0)
+					max_so_far = range[i].max;
+				memcpy(range[i].max_so_far, max_so_far, 16);
+			}
+		}
+	return index;
+}
+
+/**
+ * ccs_find_inet_range - Find an inet ACL entry which matches the request.
+ *
+ * @index: Pointer to "struct ccs_inet_index".
+ * @r:     Pointer to "struct ccs_request_info".
+ *
+ * Returns pointer to "struct ccs_inet_acl" on success, NULL otherwise.
+ *
+ * Binary search finds ranges which start at or before the address, then we
+ * walk backward until "max_so_far" proves that no earlier range can contain
+ * the address. Port numbers are compared against the matched entry.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static const struct ccs_inet_acl *ccs_find_inet_range
+(const struct ccs_inet_index *index, const struct ccs_request_info *r)
+{
+	const u8 operation = r->param.inet_network.operation;
+	const bool is_ipv6 = r->param.inet_network.is_ipv6;
+	const struct ccs_inet_range *range = index->range[operation][is_ipv6];
+	unsigned int lo = 0;
+	unsigned int hi = index->count[operation][is_ipv6];
+	u8 address[16] = { };
+	memcpy(address, r->param.inet_network.address, is_ipv6 ? 16 : 4);
+	while (lo < hi) {
+		const unsigned int mid = lo + (hi - lo) / 2;
+		if (memcmp(range[mid].min, address, 16) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	while (lo--) {
+		if (memcmp(range[lo].max_so_far, address, 16) < 0)
+			break;
+		if (memcmp(address, range[lo].max, 16) <= 0 &&
+		    ccs_compare_number_union(r->param.inet_network.port,
+					     &range[lo].acl->port))
+			return range[lo].acl;
+	}
+	return NULL;
+}
+
+/**
+ * ccs_socket_cache_key - Make search key for ccs_socket_cache_granted().
+ *
+ * @address: Pointer to "struct ccs_addr_info".
+ * @r:       Pointer to "struct ccs_request_info".
+ * @verdict: Pointer to "struct ccs_socket_verdict".
+ *
+ * Returns true if the result of this request can be remembered, false
+ * otherwise.
+ *
+ * Unconnected datagram sockets tend to send to or receive from the same peers
+ * over and over. Since entries without conditions depend only on the domain
+ * and the peer, we remember such results until ccs_acl_generation changes.
+ * The domain is identified by "struct ccs_domain_info"->serial rather than
+ * its address, for a deleted domain's memory may be reused by a new domain.
+ */
+static bool ccs_socket_cache_key(const struct ccs_addr_info *address,
+				 const struct ccs_request_info *r,
+				 struct ccs_socket_verdict *verdict)
+{
+	if (!address->inode)
+		return false;
+	if (address->operation != CCS_NETWORK_SEND
+#ifdef CONFIG_CCSECURITY_NETWORK_RECVMSG
+	    && address->operation != CCS_NETWORK_RECV
+#endif
+	    )
+		return false;
+	/* Grant log needs the matched entry. Let ccs_check_acl() find it. */
+	if (ccs_get_config(r->profile, r->type) & CCS_CONFIG_WANT_GRANT_LOG)
+		return false;
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+	/* Let ccs_check_acl() count the entry which grants this request. */
+	if (ccs_acl_profiling)
+		return false;
+#endif
+	/* Padding bytes are compared by memcmp() as well. */
+	memset(verdict, 0, sizeof(*verdict));
+	verdict->domain = ccs_current_domain()->serial;
+	verdict->generation = ccs_acl_generation;
+	memcpy(verdict->address, address->inet.address,
+	       address->inet.is_ipv6 ? 16 : 4);
+	verdict->port = address->inet.port;
+	verdict->protocol = address->protocol;
+	verdict->operation = address->operation;
+	verdict->is_ipv6 = address->inet.is_ipv6;
+	return true;
+}
+
+/**
+ * ccs_find_socket_cache - Find "struct ccs_socket_cache" of a socket.
+ *
+ * @table: Pointer to "struct ccs_socket_cache_table".
+ * @inode: Inode of the socket.
+ *
+ * Returns pointer to "struct ccs_socket_cache" if found, NULL otherwise.
+ *
+ * Since ccs_grow_socket_cache() moves elements to another table, a reader
+ * may miss an element or finish walking in a list of another table. Either
+ * case ends at NULL, and a missed element just costs ccs_check_acl().
+ *
+ * Caller holds rcu_read_lock().
+ */
+static struct ccs_socket_cache *ccs_find_socket_cache
+(const struct ccs_socket_cache_table *table, const struct inode *inode)
+{
+	struct hlist_node *pos;
+	for (pos = rcu_dereference(table->list[hash_ptr((void *) inode,
+							table->bits)].first);
+	     pos; pos = rcu_dereference(pos->next)) {
+		struct ccs_socket_cache *cache =
+			hlist_entry(pos, struct ccs_socket_cache, list);
+		if (cache->inode == inode)
+			return cache;
+	}
+	return NULL;
+}
+
+/**
+ * ccs_socket_cache_granted - Check whether a datagram peer was recently granted.
+ *
+ * @inode:   Inode of the socket.
+ * @verdict: Pointer to "struct ccs_socket_verdict" made by
+ *           ccs_socket_cache_key().
+ *
+ * Returns true if granted, false otherwise.
+ *
+ * Each socket has its own "struct ccs_socket_cache", and therefore sockets do
+ * not contend with each other.
+ */
+static bool ccs_socket_cache_granted(const struct inode *inode,
+				     const struct ccs_socket_verdict *verdict)
+{
+	const struct ccs_socket_cache *cache;
+	unsigned int seq;
+	bool found = false;
+	u8 i;
+	rcu_read_lock();
+	cache = ccs_find_socket_cache(rcu_dereference(ccs_socket_cache_table),
+				      inode);
+	if (cache) {
+		do {
+			seq = read_seqbegin(&cache->lock);
+			found = false;
+			for (i = 0; i < CCS_SOCKET_CACHE_WAYS; i++) {
+				if (memcmp(&cache->verdict[i], verdict,
+					   sizeof(*verdict)))
+					continue;
+				found = true;
+				break;
+			}
+		} while (read_seqretry(&cache->lock, seq));
+	}
+	rcu_read_unlock();
+	return found;
+}
+
+/**
+ * ccs_socket_cache_granted_fast - Check ccs_socket_cache_list without ccs_read_lock().
+ *
+ * @address: Pointer to "struct ccs_addr_info".
+ * @type:    One of values in "enum ccs_mac_index".
+ *
+ * Returns true if @address was recently granted to the current domain, false
+ * if the caller has to check permission with ccs_read_lock() held.
+ *
+ * A datagram socket sending to the same peers is checked for every packet.
+ * This is the only check which does not take ccs_read_lock(), and it answers
+ * only requests which ccs_check_acl() granted before. Other checks, including
+ * misses here, take ccs_read_lock() for the reasons described there.
+ *
+ * ccs_socket_cache_key() reads only the current domain, which cannot be
+ * released while the current thread refers to it, and its profile, which is
+ * never released. ccs_socket_cache_granted() protects ccs_socket_cache_table
+ * by itself, and compares the domain's serial number together with
+ * ccs_acl_generation. No ACL entry is dereferenced.
+ */
+static bool ccs_socket_cache_granted_fast(const struct ccs_addr_info *address,
+					  const u8 type)
+{
+	struct ccs_request_info r;
+	struct ccs_socket_verdict verdict;
+	bool granted;
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+	/* ccs_init_request_info() might have to transit to another domain. */
+	if (ccs_auto_transition_used)
+		return false;
+#endif
+	r.profile = ccs_current_domain()->profile;
+	r.type = type;
+	granted = ccs_socket_cache_key(address, &r, &verdict) &&
+		ccs_socket_cache_granted(address->inode, &verdict);
+	if (granted)
+		ccs_add_stat(perf[CCS_STAT_SOCKET_CACHE_HIT], 1);
+	return granted;
+}
+
+/**
+ * ccs_socket_cache_grant - Remember a granted datagram peer.
+ *
+ * @inode:   Inode of the socket.
+ * @verdict: Pointer to "struct ccs_socket_verdict".
+ *
+ * Returns nothing.
+ *
+ * Since the caller is using the socket, "struct ccs_socket_cache" of the
+ * socket is not released by ccs_forget_socket_cache() until we return.
+ */
+static void ccs_socket_cache_grant(const struct inode *inode,
+				   const struct ccs_socket_verdict *verdict)
+{
+	struct ccs_socket_cache *cache;
+	rcu_read_lock();
+	cache = ccs_find_socket_cache(rcu_dereference(ccs_socket_cache_table),
+				      inode);
+	rcu_read_unlock();
+	if (!cache) {
+		const unsigned int size = ccs_round2(sizeof(*cache));
+		struct ccs_socket_cache_table *table;
+		struct ccs_socket_cache *entry =
+			kzalloc(sizeof(*entry), GFP_ATOMIC | __GFP_NOWARN);
+		if (!entry)
+			return;
+		entry->inode = inode;
+		seqlock_init(&entry->lock);
+		spin_lock(&ccs_socket_cache_lock);
+		rcu_read_lock();
+		table = ccs_socket_cache_table;
+		cache = ccs_find_socket_cache(table, inode);
+		if (!cache && (!ccs_memory_quota[CCS_MEMORY_SOCKET] ||
+			       ccs_memory_used[CCS_MEMORY_SOCKET] + size <=
+			       ccs_memory_quota[CCS_MEMORY_SOCKET])) {
+			ccs_memory_used[CCS_MEMORY_SOCKET] += size;
+			hlist_add_head_rcu(&entry->list, &table->list
+					   [hash_ptr((void *) inode,
+						     table->bits)]);
+			/* Ask the garbage collector to enlarge the table. */
+			if (++ccs_socket_cache_count == 2u << table->bits &&
+			    table->bits < CCS_SOCKET_CACHE_HASH_MAX_BITS &&
+			    !test_and_set_bit(CCS_GC_DIRTY_SOCKET,
+					      &ccs_gc_dirty))
+				ccs_schedule_gc();
+			cache = entry;
+			entry = NULL;
+		}
+		rcu_read_unlock();
+		spin_unlock(&ccs_socket_cache_lock);
+		kfree(entry);
+		if (!cache)
+			return;
+	}
+	write_seqlock(&cache->lock);
+	memcpy(&cache->verdict[cache->next++], verdict, sizeof(*verdict));
+	if (cache->next == CCS_SOCKET_CACHE_WAYS)
+		cache->next = 0;
+	write_sequnlock(&cache->lock);
+}
+
+/**
+ * ccs_free_socket_cache - Release "struct ccs_socket_cache".
+ *
+ * @rcu: Pointer to "struct rcu_head".
+ *
+ * Returns nothing.
+ */
+static void ccs_free_socket_cache(struct rcu_head *rcu)
+{
+	kfree(container_of(rcu, struct ccs_socket_cache, rcu));
+}
+
+/**
+ * ccs_free_socket_cache_table - Release "struct ccs_socket_cache_table".
+ *
+ * @rcu: Pointer to "struct rcu_head".
+ *
+ * Returns nothing.
+ */
+static void ccs_free_socket_cache_table(struct rcu_head *rcu)
+{
+	struct ccs_socket_cache_table *table =
+		container_of(rcu, struct ccs_socket_cache_table, rcu);
+	kfree(table->list);
+	kfree(table);
+}
+
+/**
+ * ccs_grow_socket_cache - Enlarge hash table of "struct ccs_socket_cache".
+ *
+ * Returns nothing.
+ *
+ * Called by the garbage collector when the number of sockets with granted
+ * datagram peers reached twice the size of ccs_socket_cache_table, so that
+ * finding a socket's "struct ccs_socket_cache" does not slow down as the
+ * number of sockets grows. The table is charged to the socket cache memory
+ * quota, and is left as is if the quota or kmalloc() does not allow it.
+ */
+void ccs_grow_socket_cache(void)
+{
+	/* Only the garbage collector replaces ccs_socket_cache_table. */
+	struct ccs_socket_cache_table *old = ccs_socket_cache_table;
+	const u8 bits = old->bits + 1;
+	const size_t len = sizeof(struct hlist_head) << bits;
+	const unsigned int size = ccs_round2(sizeof(*old)) + ccs_round2(len);
+	struct ccs_socket_cache_table *table;
+	unsigned int i;
+	if (bits > CCS_SOCKET_CACHE_HASH_MAX_BITS)
+		return;
+	table = kzalloc(sizeof(*table), CCS_GFP_FLAGS);
+	if (!table)
+		return;
+	table->list = kzalloc(len, CCS_GFP_FLAGS | __GFP_NOWARN);
+	if (!table->list)
+		goto out;
+	table->size = size;
+	table->bits = bits;
+	spin_lock(&ccs_socket_cache_lock);
+	if (ccs_memory_quota[CCS_MEMORY_SOCKET] &&
+	    ccs_memory_used[CCS_MEMORY_SOCKET] - old->size + size >
+	    ccs_memory_quota[CCS_MEMORY_SOCKET]) {
+		spin_unlock(&ccs_socket_cache_lock);
+		goto out;
+	}
+	for (i = 0; i < (1u << old->bits); i++) {
+		while (old->list[i].first) {
+			struct ccs_socket_cache *cache =
+				hlist_entry(old->list[i].first,
+					    struct ccs_socket_cache, list);
+			hlist_del_rcu(&cache->list);
+			hlist_add_head_rcu(&cache->list, &table->list
+					   [hash_ptr((void *) cache->inode,
+						     bits)]);
+		}
+	}
+	ccs_memory_used[CCS_MEMORY_SOCKET] += size - old->size;
+	rcu_assign_pointer(ccs_socket_cache_table, table);
+	spin_unlock(&ccs_socket_cache_lock);
+	if (old->size)
+		call_rcu(&old->rcu, ccs_free_socket_cache_table);
+	return;
+out:
+	kfree(table->list);
+	kfree(table);
+}
+
+/**
+ * ccs_forget_socket_cache - Release granted datagram peers of a socket.
  *
- * @r:   Pointer to "struct ccs_request_info".
- * @ptr: Pointer to "struct ccs_acl_info".
+ * @inode: Inode of the socket.
  *
- * Returns true if granted, false otherwise.
+ * Returns nothing.
+ *
+ * This function is called from LSM hook for releasing inodes, for modules
+ * cannot reserve space in "struct sock" or "struct socket".
  */
-static bool ccs_check_unix_acl(struct ccs_request_info *r,
-			       const struct ccs_acl_info *ptr)
+void ccs_forget_socket_cache(const struct inode *inode)
 {
-	const struct ccs_unix_acl *acl = container_of(ptr, typeof(*acl), head);
-	return (ptr->perm & (1 << r->param.unix_network.operation)) &&
-		ccs_compare_name_union(r->param.unix_network.address,
-				       &acl->name);
+	struct ccs_socket_cache *cache;
+	spin_lock(&ccs_socket_cache_lock);
+	rcu_read_lock();
+	cache = ccs_find_socket_cache(ccs_socket_cache_table, inode);
+	if (cache) {
+		hlist_del_rcu(&cache->list);
+		ccs_socket_cache_count--;
+		ccs_memory_used[CCS_MEMORY_SOCKET] -=
+			ccs_round2(sizeof(*cache));
+	}
+	rcu_read_unlock();
+	spin_unlock(&ccs_socket_cache_lock);
+	if (cache)
+		call_rcu(&cache->rcu, ccs_free_socket_cache);
 }
 
 /**
@@ -3195,10 +4662,15 @@ static bool ccs_check_unix_acl(struct ccs_request_info *r,
  */
 static int ccs_inet_entry(const struct ccs_addr_info *address)
 {
-	const int idx = ccs_read_lock();
 	struct ccs_request_info r;
 	int error = 0;
 	const u8 type = ccs_inet2mac[address->protocol][address->operation];
+	struct ccs_socket_verdict verdict;
+	bool cacheable;
+	int idx;
+	if (type && ccs_socket_cache_granted_fast(address, type))
+		return 0;
+	idx = ccs_read_lock();
 	if (type && ccs_init_request_info(&r, type) != CCS_CONFIG_DISABLED) {
 		r.param_type = CCS_TYPE_INET_ACL;
 		r.param.inet_network.protocol = address->protocol;
@@ -3212,8 +4684,21 @@ static int ccs_inet_entry(const struct ccs_addr_info *address)
 			|| address->operation == CCS_NETWORK_RECV
 #endif
 			;
+		cacheable = ccs_socket_cache_key(address, &r, &verdict);
+		if (cacheable) {
+			if (ccs_socket_cache_granted(address->inode,
+						     &verdict)) {
+				ccs_add_stat(perf[CCS_STAT_SOCKET_CACHE_HIT],
+					     1);
+				goto out;
+			}
+			ccs_add_stat(perf[CCS_STAT_SOCKET_CACHE_MISS], 1);
+		}
 		error = ccs_check_acl(&r);
+		if (cacheable && !error && r.granted && !r.matched_acl->cond)
+			ccs_socket_cache_grant(address->inode, &verdict);
 	}
+out:
 	ccs_read_unlock(idx);
 	return error;
 }
@@ -3470,6 +4955,7 @@ static int __ccs_socket_sendmsg_permission(struct socket *sock,
 		return 0;
 	address.protocol = type;
 	address.operation = CCS_NETWORK_SEND;
+	address.inode = SOCK_INODE(sock);
 	if (family == PF_UNIX)
 		return ccs_check_unix_address((struct sockaddr *)
 					      msg->msg_name, msg->msg_namelen,
@@ -3542,6 +5028,7 @@ static int __ccs_socket_post_recvmsg_permission(struct sock *sk,
 		return 0;
 	}
 	address.operation = CCS_NETWORK_RECV;
+	address.inode = sk->sk_socket ? SOCK_INODE(sk->sk_socket) : NULL;
 	switch (family) {
 	case PF_INET6:
 		{
@@ -3870,6 +5357,103 @@ static bool ccs_check_env_acl(struct ccs_request_info *r,
 	return ccs_path_matches_pattern(r->param.environ.name, acl->env);
 }
 
+/**
+ * ccs_collect_env_acl - Collect "misc env" ACL entries with literal names.
+ *
+ * @domain: Pointer to "struct ccs_domain_info".
+ * @index:  Pointer to "struct ccs_env_index". NULL if only counting.
+ *
+ * Returns number of entries found.
+ *
+ * Entries with conditions or wildcards are not collected. They are handled
+ * by ccs_find_acl().
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static unsigned int ccs_collect_env_acl(const struct ccs_domain_info *domain,
+					struct ccs_env_index *index)
+{
+	const struct list_head *list = &domain->acl_info_list;
+	struct ccs_acl_info *ptr;
+	unsigned int count = 0;
+	u16 i = 0;
+retry:
+	list_for_each_entry(ptr, list, list) {
+		const struct ccs_env_acl *acl;
+		unsigned int hash;
+		if (ptr->is_deleted || ptr->type != CCS_TYPE_ENV_ACL ||
+		    ptr->cond)
+			continue;
+		acl = container_of(ptr, typeof(*acl), head);
+		if (acl->env->is_patterned)
+			continue;
+		count++;
+		if (!index)
+			continue;
+		hash = acl->env->hash;
+		while (index->slot[hash & index->mask])
+			hash++;
+		index->slot[hash & index->mask] = acl;
+	}
+	for (; i < CCS_MAX_ACL_GROUPS; i++) {
+		if (!test_bit(i, domain->group))
+			continue;
+		list = &domain->ns->acl_group[i++];
+		goto retry;
+	}
+	return count;
+}
+
+/**
+ * ccs_build_env_index - Build "struct ccs_env_index" for a domain.
+ *
+ * @domain: Pointer to "struct ccs_domain_info".
+ *
+ * Returns pointer to "struct ccs_env_index" on success, NULL otherwise.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static struct ccs_env_index *ccs_build_env_index
+(const struct ccs_domain_info *domain)
+{
+	const unsigned int count = ccs_collect_env_acl(domain, NULL);
+	struct ccs_env_index *index;
+	unsigned int slots = 1;
+	/* Keep the table at most half full. */
+	while (slots < count * 2)
+		slots <<= 1;
+	index = ccs_alloc_domain_index(sizeof(*index) + (slots - 1) *
+				       sizeof(index->slot[0]));
+	if (!index)
+		return NULL;
+	index->mask = slots - 1;
+	if (count)
+		ccs_collect_env_acl(domain, index);
+	return index;
+}
+
+/**
+ * ccs_find_env_slot - Find a "misc env" ACL entry with literal name.
+ *
+ * @index: Pointer to "struct ccs_env_index".
+ * @name:  Pointer to "struct ccs_path_info".
+ *
+ * Returns pointer to "struct ccs_env_acl" on success, NULL otherwise.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static const struct ccs_env_acl *ccs_find_env_slot
+(const struct ccs_env_index *index, const struct ccs_path_info *name)
+{
+	const struct ccs_env_acl *acl;
+	unsigned int hash;
+	for (hash = name->hash; ; hash++) {
+		acl = index->slot[hash & index->mask];
+		if (!acl || !ccs_pathcmp(acl->env, name))
+			return acl;
+	}
+}
+
 /**
  * ccs_env_perm - Check permission for environment variable's name.
  *
@@ -3903,12 +5487,10 @@ static int ccs_environ(struct ccs_execve *ee)
 {
 	struct ccs_request_info *r = &ee->r;
 	struct linux_binprm *bprm = ee->bprm;
-	/* env_page.data is allocated by ccs_dump_page(). */
-	struct ccs_page_dump env_page = { };
+	const struct ccs_bprm_strings *strings;
 	char *arg_ptr; /* Size is CCS_EXEC_TMPSIZE bytes */
 	int arg_len = 0;
-	unsigned long pos = bprm->p;
-	int offset = pos % PAGE_SIZE;
+	size_t offset = 0;
 	int argv_count = bprm->argc;
 	int envp_count = bprm->envc;
 	/* printk(KERN_DEBUG "start %d %d\n", argv_count, envp_count); */
@@ -3921,57 +5503,48 @@ static int ccs_environ(struct ccs_execve *ee)
 	arg_ptr = kzalloc(CCS_EXEC_TMPSIZE, CCS_GFP_FLAGS);
 	if (!arg_ptr)
 		goto out;
-	while (error == -ENOMEM) {
-		if (!ccs_dump_page(bprm, pos, &env_page))
-			goto out;
-		pos += PAGE_SIZE - offset;
-		/* Read. */
-		while (argv_count && offset < PAGE_SIZE) {
-			if (!env_page.data[offset++])
-				argv_count--;
+	strings = ccs_load_bprm(ee);
+	if (!strings)
+		goto out;
+	/* Skip argv[]. */
+	while (argv_count && offset < strings->len) {
+		if (!strings->data[offset++])
+			argv_count--;
+	}
+	while (offset < strings->len) {
+		const unsigned char c = strings->data[offset++];
+		if (c && arg_len < CCS_EXEC_TMPSIZE - 10) {
+			if (c == '=') {
+				arg_ptr[arg_len++] = '\0';
+			} else if (c == '\\') {
+				arg_ptr[arg_len++] = '\\';
+				arg_ptr[arg_len++] = '\\';
+			} else if (c > ' ' && c < 127) {
+				arg_ptr[arg_len++] = c;
+			} else {
+				arg_ptr[arg_len++] = '\\';
+				arg_ptr[arg_len++] = (c >> 6) + '0';
+				arg_ptr[arg_len++] = ((c >> 3) & 7) + '0';
+				arg_ptr[arg_len++] = (c & 7) + '0';
+			}
+		} else {
+			arg_ptr[arg_len] = '\0';
 		}
-		if (argv_count) {
-			offset = 0;
+		if (c)
 			continue;
+		if (ccs_env_perm(r, arg_ptr)) {
+			error = -EPERM;
+			break;
 		}
-		while (offset < PAGE_SIZE) {
-			const unsigned char c = env_page.data[offset++];
-			if (c && arg_len < CCS_EXEC_TMPSIZE - 10) {
-				if (c == '=') {
-					arg_ptr[arg_len++] = '\0';
-				} else if (c == '\\') {
-					arg_ptr[arg_len++] = '\\';
-					arg_ptr[arg_len++] = '\\';
-				} else if (c > ' ' && c < 127) {
-					arg_ptr[arg_len++] = c;
-				} else {
-					arg_ptr[arg_len++] = '\\';
-					arg_ptr[arg_len++] = (c >> 6) + '0';
-					arg_ptr[arg_len++]
-						= ((c >> 3) & 7) + '0';
-					arg_ptr[arg_len++] = (c & 7) + '0';
-				}
-			} else {
-				arg_ptr[arg_len] = '\0';
-			}
-			if (c)
-				continue;
-			if (ccs_env_perm(r, arg_ptr)) {
-				error = -EPERM;
-				break;
-			}
-			if (!--envp_count) {
-				error = 0;
-				break;
-			}
-			arg_len = 0;
+		if (!--envp_count) {
+			error = 0;
+			break;
 		}
-		offset = 0;
+		arg_len = 0;
 	}
 out:
 	if (r->mode != CCS_CONFIG_ENFORCING)
 		error = 0;
-	kfree(env_page.data);
 	kfree(arg_ptr);
 	return error;
 }
@@ -4069,16 +5642,17 @@ static bool ccs_scan_bprm(struct ccs_execve *ee,
 			  const u16 envc, const struct ccs_envp *envp)
 {
 	struct linux_binprm *bprm = ee->bprm;
-	struct ccs_page_dump *dump = &ee->dump;
+	const struct ccs_bprm_strings *strings = ccs_load_bprm(ee);
 	char *arg_ptr = ee->tmp;
 	int arg_len = 0;
-	unsigned long pos = bprm->p;
-	int offset = pos % PAGE_SIZE;
+	size_t offset = 0;
 	int argv_count = bprm->argc;
 	int envp_count = bprm->envc;
 	bool result = true;
 	u8 local_checked[32];
 	u8 *checked;
+	if (!strings)
+		return false;
 	if (argc + envc <= sizeof(local_checked)) {
 		checked = local_checked;
 		memset(local_checked, 0, sizeof(local_checked));
@@ -4087,65 +5661,50 @@ static bool ccs_scan_bprm(struct ccs_execve *ee,
 		if (!checked)
 			return false;
 	}
-	while (argv_count || envp_count) {
-		if (!ccs_dump_page(bprm, pos, dump)) {
-			result = false;
-			goto out;
-		}
-		pos += PAGE_SIZE - offset;
-		while (offset < PAGE_SIZE) {
-			/* Read. */
-			const char *kaddr = dump->data;
-			const unsigned char c = kaddr[offset++];
-			if (c && arg_len < CCS_EXEC_TMPSIZE - 10) {
-				if (c == '\\') {
-					arg_ptr[arg_len++] = '\\';
-					arg_ptr[arg_len++] = '\\';
-				} else if (c > ' ' && c < 127) {
-					arg_ptr[arg_len++] = c;
-				} else {
-					arg_ptr[arg_len++] = '\\';
-					arg_ptr[arg_len++] = (c >> 6) + '0';
-					arg_ptr[arg_len++] =
-						((c >> 3) & 7) + '0';
-					arg_ptr[arg_len++] = (c & 7) + '0';
-				}
+	while (offset < strings->len) {
+		/* Read. */
+		const unsigned char c = strings->data[offset++];
+		if (c && arg_len < CCS_EXEC_TMPSIZE - 10) {
+			if (c == '\\') {
+				arg_ptr[arg_len++] = '\\';
+				arg_ptr[arg_len++] = '\\';
+			} else if (c > ' ' && c < 127) {
+				arg_ptr[arg_len++] = c;
 			} else {
-				arg_ptr[arg_len] = '\0';
+				arg_ptr[arg_len++] = '\\';
+				arg_ptr[arg_len++] = (c >> 6) + '0';
+				arg_ptr[arg_len++] = ((c >> 3) & 7) + '0';
+				arg_ptr[arg_len++] = (c & 7) + '0';
 			}
-			if (c)
-				continue;
-			/* Check. */
-			if (argv_count) {
-				if (!ccs_argv(bprm->argc - argv_count,
-					      arg_ptr, argc, argv,
-					      checked)) {
+		} else {
+			arg_ptr[arg_len] = '\0';
+		}
+		if (c)
+			continue;
+		/* Check. */
+		if (argv_count) {
+			if (!ccs_argv(bprm->argc - argv_count, arg_ptr, argc,
+				      argv, checked)) {
+				result = false;
+				break;
+			}
+			argv_count--;
+		} else if (envp_count) {
+			char *cp = strchr(arg_ptr, '=');
+			if (cp) {
+				*cp = '\0';
+				if (!ccs_envp(arg_ptr, cp + 1, envc, envp,
+					      checked + argc)) {
 					result = false;
 					break;
 				}
-				argv_count--;
-			} else if (envp_count) {
-				char *cp = strchr(arg_ptr, '=');
-				if (cp) {
-					*cp = '\0';
-					if (!ccs_envp(arg_ptr, cp + 1,
-						      envc, envp,
-						      checked + argc)) {
-						result = false;
-						break;
-					}
-				}
-				envp_count--;
-			} else {
-				break;
 			}
-			arg_len = 0;
-		}
-		offset = 0;
-		if (!result)
+			envp_count--;
+		} else {
 			break;
+		}
+		arg_len = 0;
 	}
-out:
 	if (result) {
 		int i;
 		/* Check not-yet-checked entries. */
@@ -4218,31 +5777,32 @@ static bool ccs_scan_exec_realpath(struct file *file,
 /**
  * ccs_get_attributes - Revalidate "struct inode".
  *
- * @obj: Pointer to "struct ccs_obj_info".
+ * @obj:  Pointer to "struct ccs_obj_info".
+ * @mask: Bitmask of "enum ccs_path_stat_index" to fetch.
  *
  * Returns nothing.
+ *
+ * Slots which were already fetched for @obj are not fetched again.
  */
-void ccs_get_attributes(struct ccs_obj_info *obj)
+void ccs_get_attributes(struct ccs_obj_info *obj, const u8 mask)
 {
 	u8 i;
-	struct dentry *dentry = NULL;
+	const u8 todo = mask & ~obj->stat_fetched;
 
+	if (!todo)
+		return;
 	for (i = 0; i < CCS_MAX_PATH_STAT; i++) {
 		struct inode *inode;
-		switch (i) {
-		case CCS_PATH1:
+		struct dentry *dentry;
+		if (!(todo & (1 << i)))
+			continue;
+		if (i < CCS_PATH2) /* i == CCS_PATH1 || i == CCS_PATH1_PARENT */
 			dentry = obj->path1.dentry;
-			if (!dentry)
-				continue;
-			break;
-		case CCS_PATH2:
+		else
 			dentry = obj->path2.dentry;
-			if (!dentry)
-				continue;
-			break;
-		default:
-			if (!dentry)
-				continue;
+		if (!dentry)
+			continue;
+		if (i & 1) { /* i == CCS_PATH1_PARENT || i == CCS_PATH2_PARENT */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 5, 0)
 			spin_lock(&dcache_lock);
 			dentry = dget(dentry->d_parent);
@@ -4250,7 +5810,6 @@ void ccs_get_attributes(struct ccs_obj_info *obj)
 #else
 			dentry = dget_parent(dentry);
 #endif
-			break;
 		}
 		inode = d_backing_inode(dentry);
 		if (inode) {
@@ -4270,6 +5829,158 @@ void ccs_get_attributes(struct ccs_obj_info *obj)
 		if (i & 1) /* i == CCS_PATH1_PARENT || i == CCS_PATH2_PARENT */
 			dput(dentry);
 	}
+	obj->stat_fetched |= todo;
+}
+
+/**
+ * ccs_condition_value - Fetch a numeric operand of "struct ccs_condition_op".
+ *
+ * @var:   Pointer to "struct ccs_condition_var".
+ * @index: One of values in "enum ccs_conditions_index".
+ * @value: Pointer to "unsigned long" to store the value.
+ *
+ * Returns true on success, false otherwise.
+ *
+ * Credentials of current thread are loaded only once per ccs_condition() call.
+ */
+static bool ccs_condition_value(struct ccs_condition_var *var, const u8 index,
+				unsigned long *value)
+{
+	struct ccs_obj_info *obj = var->obj;
+	struct ccs_mini_stat *stat;
+	u8 stat_index;
+	if (index < CCS_TASK_PID) {
+		if (!var->cred_loaded) {
+			unsigned long *cred = var->cred;
+			cred[CCS_TASK_UID] = from_kuid(&init_user_ns,
+						       current_uid());
+			cred[CCS_TASK_EUID] = from_kuid(&init_user_ns,
+							current_euid());
+			cred[CCS_TASK_SUID] = from_kuid(&init_user_ns,
+							current_suid());
+			cred[CCS_TASK_FSUID] = from_kuid(&init_user_ns,
+							 current_fsuid());
+			cred[CCS_TASK_GID] = from_kgid(&init_user_ns,
+						       current_gid());
+			cred[CCS_TASK_EGID] = from_kgid(&init_user_ns,
+							current_egid());
+			cred[CCS_TASK_SGID] = from_kgid(&init_user_ns,
+							current_sgid());
+			cred[CCS_TASK_FSGID] = from_kgid(&init_user_ns,
+							 current_fsgid());
+			var->cred_loaded = true;
+		}
+		*value = var->cred[index];
+		return true;
+	}
+	switch (index) {
+	case CCS_TASK_PID:
+		*value = ccs_sys_getpid();
+		return true;
+	case CCS_TASK_PPID:
+		*value = ccs_sys_getppid();
+		return true;
+	case CCS_EXEC_ARGC:
+		if (!var->bprm)
+			return false;
+		*value = var->bprm->argc;
+		return true;
+	case CCS_EXEC_ENVC:
+		if (!var->bprm)
+			return false;
+		*value = var->bprm->envc;
+		return true;
+	case CCS_TASK_TYPE:
+		*value = ((u8) ccs_current_flags())
+			& CCS_TASK_IS_EXECUTE_HANDLER;
+		return true;
+	case CCS_PATH1_UID:
+	case CCS_PATH1_GID:
+	case CCS_PATH1_INO:
+	case CCS_PATH1_MAJOR:
+	case CCS_PATH1_MINOR:
+	case CCS_PATH1_TYPE:
+	case CCS_PATH1_DEV_MAJOR:
+	case CCS_PATH1_DEV_MINOR:
+	case CCS_PATH1_PERM:
+		stat_index = CCS_PATH1;
+		break;
+	case CCS_PATH2_UID:
+	case CCS_PATH2_GID:
+	case CCS_PATH2_INO:
+	case CCS_PATH2_MAJOR:
+	case CCS_PATH2_MINOR:
+	case CCS_PATH2_TYPE:
+	case CCS_PATH2_DEV_MAJOR:
+	case CCS_PATH2_DEV_MINOR:
+	case CCS_PATH2_PERM:
+		stat_index = CCS_PATH2;
+		break;
+	case CCS_PATH1_PARENT_UID:
+	case CCS_PATH1_PARENT_GID:
+	case CCS_PATH1_PARENT_INO:
+	case CCS_PATH1_PARENT_PERM:
+		stat_index = CCS_PATH1_PARENT;
+		break;
+	case CCS_PATH2_PARENT_UID:
+	case CCS_PATH2_PARENT_GID:
+	case CCS_PATH2_PARENT_INO:
+	case CCS_PATH2_PARENT_PERM:
+		stat_index = CCS_PATH2_PARENT;
+		break;
+	default:
+		return false;
+	}
+	if (!obj)
+		return false;
+	ccs_get_attributes(obj, var->stat_mask);
+	if (!obj->stat_valid[stat_index])
+		return false;
+	stat = &obj->stat[stat_index];
+	switch (index) {
+	case CCS_PATH1_UID:
+	case CCS_PATH2_UID:
+	case CCS_PATH1_PARENT_UID:
+	case CCS_PATH2_PARENT_UID:
+		*value = from_kuid(&init_user_ns, stat->uid);
+		break;
+	case CCS_PATH1_GID:
+	case CCS_PATH2_GID:
+	case CCS_PATH1_PARENT_GID:
+	case CCS_PATH2_PARENT_GID:
+		*value = from_kgid(&init_user_ns, stat->gid);
+		break;
+	case CCS_PATH1_INO:
+	case CCS_PATH2_INO:
+	case CCS_PATH1_PARENT_INO:
+	case CCS_PATH2_PARENT_INO:
+		*value = stat->ino;
+		break;
+	case CCS_PATH1_MAJOR:
+	case CCS_PATH2_MAJOR:
+		*value = MAJOR(stat->dev);
+		break;
+	case CCS_PATH1_MINOR:
+	case CCS_PATH2_MINOR:
+		*value = MINOR(stat->dev);
+		break;
+	case CCS_PATH1_TYPE:
+	case CCS_PATH2_TYPE:
+		*value = stat->mode & S_IFMT;
+		break;
+	case CCS_PATH1_DEV_MAJOR:
+	case CCS_PATH2_DEV_MAJOR:
+		*value = MAJOR(stat->rdev);
+		break;
+	case CCS_PATH1_DEV_MINOR:
+	case CCS_PATH2_DEV_MINOR:
+		*value = MINOR(stat->rdev);
+		break;
+	default: /* CCS_PATH*_PERM */
+		*value = stat->mode & S_IALLUGO;
+		break;
+	}
+	return true;
 }
 
 /**
@@ -4281,374 +5992,108 @@ void ccs_get_attributes(struct ccs_obj_info *obj)
  * Returns true on success, false otherwise.
  *
  * Caller holds ccs_read_lock().
+ *
+ * This function runs "struct ccs_condition"->ops[] which
+ * ccs_compile_condition() built when @cond was committed, and then checks
+ * argv[] and envp[].
  */
 static bool ccs_condition(struct ccs_request_info *r,
 			  const struct ccs_condition *cond)
 {
-	const u32 ccs_flags = ccs_current_flags();
-	u32 i;
-	unsigned long min_v[2] = { 0, 0 };
-	unsigned long max_v[2] = { 0, 0 };
+	struct ccs_condition_var var;
+	const struct ccs_condition_op *op;
 	const struct ccs_condition_element *condp;
 	const struct ccs_number_union *numbers_p;
 	const struct ccs_name_union *names_p;
 	const struct ccs_argv *argv;
 	const struct ccs_envp *envp;
-	struct ccs_obj_info *obj;
-	u16 condc;
 	u16 argc;
 	u16 envc;
-	struct linux_binprm *bprm = NULL;
+	u16 i;
 	if (!cond)
 		return true;
-	condc = cond->condc;
 	argc = cond->argc;
 	envc = cond->envc;
-	obj = r->obj;
-	if (r->ee)
-		bprm = r->ee->bprm;
-	if (!bprm && (argc || envc))
+	var.obj = r->obj;
+	var.bprm = r->ee ? r->ee->bprm : NULL;
+	var.stat_mask = cond->stat_mask;
+	var.cred_loaded = false;
+	if (!var.bprm && (argc || envc))
 		return false;
-	condp = (struct ccs_condition_element *) (cond + 1);
-	numbers_p = (const struct ccs_number_union *) (condp + condc);
-	names_p = (const struct ccs_name_union *)
-		(numbers_p + cond->numbers_count);
-	argv = (const struct ccs_argv *) (names_p + cond->names_count);
-	envp = (const struct ccs_envp *) (argv + argc);
-	for (i = 0; i < condc; i++) {
-		const bool match = condp->equals;
-		const u8 left = condp->left;
-		const u8 right = condp->right;
-		bool is_bitop[2] = { false, false };
-		u8 j;
-		condp++;
-		/* Check argv[] and envp[] later. */
-		if (left == CCS_ARGV_ENTRY || left == CCS_ENVP_ENTRY)
-			continue;
-		/* Check string expressions. */
-		if (right == CCS_NAME_UNION) {
-			const struct ccs_name_union *ptr = names_p++;
-			switch (left) {
-				struct ccs_path_info *symlink;
-				struct ccs_execve *ee;
-				struct file *file;
-			case CCS_SYMLINK_TARGET:
-				symlink = obj ? obj->symlink_target : NULL;
+	for (i = 0, op = cond->ops; i < cond->opc; i++, op++) {
+		const bool match = op->equals;
+		unsigned long min_v;
+		unsigned long max_v;
+		switch (op->type) {
+			struct ccs_path_info *symlink;
+			struct file *file;
+		case CCS_COND_OP_NAME:
+			if (op->left == CCS_SYMLINK_TARGET) {
+				symlink = var.obj ? var.obj->symlink_target :
+					NULL;
 				if (!symlink ||
-				    !ccs_compare_name_union(symlink, ptr)
+				    !ccs_compare_name_union(symlink, op->ptr)
 				    == match)
-					goto out;
-				break;
-			case CCS_EXEC_REALPATH:
-				ee = r->ee;
-				file = ee ? ee->bprm->file : NULL;
-				if (!ccs_scan_exec_realpath(file, ptr, match))
-					goto out;
-				break;
+					return false;
+			} else {
+				file = var.bprm ? var.bprm->file : NULL;
+				if (!ccs_scan_exec_realpath(file, op->ptr,
+							    match))
+					return false;
 			}
 			continue;
-		}
-		/* Check numeric or bit-op expressions. */
-		for (j = 0; j < 2; j++) {
-			const u8 index = j ? right : left;
-			unsigned long value = 0;
-			switch (index) {
-			case CCS_TASK_UID:
-				value = from_kuid(&init_user_ns,
-						  current_uid());
-				break;
-			case CCS_TASK_EUID:
-				value = from_kuid(&init_user_ns,
-						  current_euid());
-				break;
-			case CCS_TASK_SUID:
-				value = from_kuid(&init_user_ns,
-						  current_suid());
-				break;
-			case CCS_TASK_FSUID:
-				value = from_kuid(&init_user_ns,
-						  current_fsuid());
-				break;
-			case CCS_TASK_GID:
-				value = from_kgid(&init_user_ns,
-						  current_gid());
-				break;
-			case CCS_TASK_EGID:
-				value = from_kgid(&init_user_ns,
-						  current_egid());
-				break;
-			case CCS_TASK_SGID:
-				value = from_kgid(&init_user_ns,
-						  current_sgid());
-				break;
-			case CCS_TASK_FSGID:
-				value = from_kgid(&init_user_ns,
-						  current_fsgid());
-				break;
-			case CCS_TASK_PID:
-				value = ccs_sys_getpid();
-				break;
-			case CCS_TASK_PPID:
-				value = ccs_sys_getppid();
-				break;
-			case CCS_TYPE_IS_SOCKET:
-				value = S_IFSOCK;
-				break;
-			case CCS_TYPE_IS_SYMLINK:
-				value = S_IFLNK;
-				break;
-			case CCS_TYPE_IS_FILE:
-				value = S_IFREG;
-				break;
-			case CCS_TYPE_IS_BLOCK_DEV:
-				value = S_IFBLK;
-				break;
-			case CCS_TYPE_IS_DIRECTORY:
-				value = S_IFDIR;
-				break;
-			case CCS_TYPE_IS_CHAR_DEV:
-				value = S_IFCHR;
-				break;
-			case CCS_TYPE_IS_FIFO:
-				value = S_IFIFO;
-				break;
-			case CCS_MODE_SETUID:
-				value = S_ISUID;
-				break;
-			case CCS_MODE_SETGID:
-				value = S_ISGID;
-				break;
-			case CCS_MODE_STICKY:
-				value = S_ISVTX;
-				break;
-			case CCS_MODE_OWNER_READ:
-				value = S_IRUSR;
-				break;
-			case CCS_MODE_OWNER_WRITE:
-				value = S_IWUSR;
-				break;
-			case CCS_MODE_OWNER_EXECUTE:
-				value = S_IXUSR;
-				break;
-			case CCS_MODE_GROUP_READ:
-				value = S_IRGRP;
-				break;
-			case CCS_MODE_GROUP_WRITE:
-				value = S_IWGRP;
-				break;
-			case CCS_MODE_GROUP_EXECUTE:
-				value = S_IXGRP;
-				break;
-			case CCS_MODE_OTHERS_READ:
-				value = S_IROTH;
-				break;
-			case CCS_MODE_OTHERS_WRITE:
-				value = S_IWOTH;
-				break;
-			case CCS_MODE_OTHERS_EXECUTE:
-				value = S_IXOTH;
-				break;
-			case CCS_EXEC_ARGC:
-				if (!bprm)
-					goto out;
-				value = bprm->argc;
-				break;
-			case CCS_EXEC_ENVC:
-				if (!bprm)
-					goto out;
-				value = bprm->envc;
-				break;
-			case CCS_TASK_TYPE:
-				value = ((u8) ccs_flags)
-					& CCS_TASK_IS_EXECUTE_HANDLER;
-				break;
-			case CCS_TASK_EXECUTE_HANDLER:
-				value = CCS_TASK_IS_EXECUTE_HANDLER;
-				break;
-			case CCS_NUMBER_UNION:
-				/* Fetch values later. */
-				break;
-			default:
-				if (!obj)
-					goto out;
-				if (!obj->validate_done) {
-					ccs_get_attributes(obj);
-					obj->validate_done = true;
-				}
-				{
-					u8 stat_index;
-					struct ccs_mini_stat *stat;
-					switch (index) {
-					case CCS_PATH1_UID:
-					case CCS_PATH1_GID:
-					case CCS_PATH1_INO:
-					case CCS_PATH1_MAJOR:
-					case CCS_PATH1_MINOR:
-					case CCS_PATH1_TYPE:
-					case CCS_PATH1_DEV_MAJOR:
-					case CCS_PATH1_DEV_MINOR:
-					case CCS_PATH1_PERM:
-						stat_index = CCS_PATH1;
-						break;
-					case CCS_PATH2_UID:
-					case CCS_PATH2_GID:
-					case CCS_PATH2_INO:
-					case CCS_PATH2_MAJOR:
-					case CCS_PATH2_MINOR:
-					case CCS_PATH2_TYPE:
-					case CCS_PATH2_DEV_MAJOR:
-					case CCS_PATH2_DEV_MINOR:
-					case CCS_PATH2_PERM:
-						stat_index = CCS_PATH2;
-						break;
-					case CCS_PATH1_PARENT_UID:
-					case CCS_PATH1_PARENT_GID:
-					case CCS_PATH1_PARENT_INO:
-					case CCS_PATH1_PARENT_PERM:
-						stat_index = CCS_PATH1_PARENT;
-						break;
-					case CCS_PATH2_PARENT_UID:
-					case CCS_PATH2_PARENT_GID:
-					case CCS_PATH2_PARENT_INO:
-					case CCS_PATH2_PARENT_PERM:
-						stat_index = CCS_PATH2_PARENT;
-						break;
-					default:
-						goto out;
-					}
-					if (!obj->stat_valid[stat_index])
-						goto out;
-					stat = &obj->stat[stat_index];
-					switch (index) {
-					case CCS_PATH1_UID:
-					case CCS_PATH2_UID:
-					case CCS_PATH1_PARENT_UID:
-					case CCS_PATH2_PARENT_UID:
-						value = from_kuid
-							(&init_user_ns,
-							 stat->uid);
-						break;
-					case CCS_PATH1_GID:
-					case CCS_PATH2_GID:
-					case CCS_PATH1_PARENT_GID:
-					case CCS_PATH2_PARENT_GID:
-						value = from_kgid
-							(&init_user_ns,
-							 stat->gid);
-						break;
-					case CCS_PATH1_INO:
-					case CCS_PATH2_INO:
-					case CCS_PATH1_PARENT_INO:
-					case CCS_PATH2_PARENT_INO:
-						value = stat->ino;
-						break;
-					case CCS_PATH1_MAJOR:
-					case CCS_PATH2_MAJOR:
-						value = MAJOR(stat->dev);
-						break;
-					case CCS_PATH1_MINOR:
-					case CCS_PATH2_MINOR:
-						value = MINOR(stat->dev);
-						break;
-					case CCS_PATH1_TYPE:
-					case CCS_PATH2_TYPE:
-						value = stat->mode & S_IFMT;
-						break;
-					case CCS_PATH1_DEV_MAJOR:
-					case CCS_PATH2_DEV_MAJOR:
-						value = MAJOR(stat->rdev);
-						break;
-					case CCS_PATH1_DEV_MINOR:
-					case CCS_PATH2_DEV_MINOR:
-						value = MINOR(stat->rdev);
-						break;
-					case CCS_PATH1_PERM:
-					case CCS_PATH2_PERM:
-					case CCS_PATH1_PARENT_PERM:
-					case CCS_PATH2_PARENT_PERM:
-						value = stat->mode & S_IALLUGO;
-						break;
-					}
-				}
-				break;
-			}
-			max_v[j] = value;
-			min_v[j] = value;
-			switch (index) {
-			case CCS_MODE_SETUID:
-			case CCS_MODE_SETGID:
-			case CCS_MODE_STICKY:
-			case CCS_MODE_OWNER_READ:
-			case CCS_MODE_OWNER_WRITE:
-			case CCS_MODE_OWNER_EXECUTE:
-			case CCS_MODE_GROUP_READ:
-			case CCS_MODE_GROUP_WRITE:
-			case CCS_MODE_GROUP_EXECUTE:
-			case CCS_MODE_OTHERS_READ:
-			case CCS_MODE_OTHERS_WRITE:
-			case CCS_MODE_OTHERS_EXECUTE:
-				is_bitop[j] = true;
-			}
-		}
-		if (left == CCS_NUMBER_UNION) {
-			/* Fetch values now. */
-			const struct ccs_number_union *ptr = numbers_p++;
-			min_v[0] = ptr->values[0];
-			max_v[0] = ptr->values[1];
-		}
-		if (right == CCS_NUMBER_UNION) {
-			/* Fetch values now. */
-			const struct ccs_number_union *ptr = numbers_p++;
-			if (ptr->group) {
-				if (ccs_number_matches_group(min_v[0],
-							     max_v[0],
-							     ptr->group)
-				    == match)
-					continue;
+		case CCS_COND_OP_GROUP:
+			if (op->left == CCS_NUMBER_UNION) {
+				min_v = op->values[0];
+				max_v = op->values[1];
+			} else if (ccs_condition_value(&var, op->left,
+						       &min_v)) {
+				max_v = min_v;
 			} else {
-				if ((min_v[0] <= ptr->values[1] &&
-				     max_v[0] >= ptr->values[0]) == match)
-					continue;
+				return false;
 			}
-			goto out;
+			if (ccs_number_matches_group(min_v, max_v, op->ptr)
+			    == match)
+				continue;
+			return false;
+		case CCS_COND_OP_FALSE:
+			return false;
 		}
-		/*
-		 * Bit operation is valid only when counterpart value
-		 * represents permission.
-		 */
-		if (is_bitop[0] && is_bitop[1]) {
-			goto out;
-		} else if (is_bitop[0]) {
-			switch (right) {
-			case CCS_PATH1_PERM:
-			case CCS_PATH1_PARENT_PERM:
-			case CCS_PATH2_PERM:
-			case CCS_PATH2_PARENT_PERM:
-				if (!(max_v[0] & max_v[1]) == !match)
-					continue;
-			}
-			goto out;
-		} else if (is_bitop[1]) {
-			switch (left) {
-			case CCS_PATH1_PERM:
-			case CCS_PATH1_PARENT_PERM:
-			case CCS_PATH2_PERM:
-			case CCS_PATH2_PARENT_PERM:
-				if (!(max_v[0] & max_v[1]) == !match)
-					continue;
-			}
-			goto out;
+		if (!ccs_condition_value(&var, op->left, &min_v))
+			return false;
+		switch (op->type) {
+		case CCS_COND_OP_RANGE:
+			if ((min_v >= op->values[0] &&
+			     min_v <= op->values[1]) == match)
+				continue;
+			break;
+		case CCS_COND_OP_BITOP:
+			/*
+			 * Bit operation is valid only when counterpart value
+			 * represents permission.
+			 */
+			if (!(min_v & op->values[0]) == !match)
+				continue;
+			break;
+		case CCS_COND_OP_COMPARE:
+			if (!ccs_condition_value(&var, op->right, &max_v))
+				return false;
+			if ((min_v == max_v) == match)
+				continue;
+			break;
 		}
-		/* Normal value range comparison. */
-		if ((min_v[0] <= max_v[1] && max_v[0] >= min_v[1]) == match)
-			continue;
-out:
 		return false;
 	}
 	/* Check argv[] and envp[] now. */
-	if (r->ee && (argc || envc))
-		return ccs_scan_bprm(r->ee, argc, argv, envc, envp);
-	return true;
+	if (!r->ee || !(argc || envc))
+		return true;
+	condp = (const struct ccs_condition_element *) (cond + 1);
+	numbers_p = (const struct ccs_number_union *) (condp + cond->condc);
+	names_p = (const struct ccs_name_union *)
+		(numbers_p + cond->numbers_count);
+	argv = (const struct ccs_argv *) (names_p + cond->names_count);
+	envp = (const struct ccs_envp *) (argv + argc);
+	return ccs_scan_bprm(r->ee, argc, argv, envc, envp);
 }
 
 #ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
@@ -7,6 +7,7 @@
  */
 
 #include "internal.h"
+#include "trace.h"
 
 /***** SECTION1: Constants definition *****/
 
@@ -369,12 +370,75 @@ static const char * const ccs_policy_headers[CCS_MAX_POLICY_STAT] = {
 	[CCS_STAT_POLICY_ENFORCING]  = "violation in enforcing mode:",
 };
 
+/* String table for /proc/ccs/stat interface. */
+static const char * const ccs_perf_headers[CCS_MAX_PERF_STAT] = {
+	[CCS_STAT_REALPATH]          = "realpath:",
+#ifdef CONFIG_CCSECURITY_NETWORK
+	[CCS_STAT_SOCKET_CACHE_HIT]  = "socket cache hit:",
+	[CCS_STAT_SOCKET_CACHE_MISS] = "socket cache miss:",
+#endif
+	[CCS_STAT_AUDIT_DROPPED]     = "dropped audit log:",
+	[CCS_STAT_QUERY_TIMEOUT]     = "timed out query:",
+	[CCS_STAT_GC_BATCHES]        = "garbage collector batch:",
+	[CCS_STAT_GC_ELEMENTS]       = "garbage collected element:",
+};
+
 /* String table for /proc/ccs/stat interface. */
 static const char * const ccs_memory_headers[CCS_MAX_MEMORY_STAT] = {
 	[CCS_MEMORY_POLICY]     = "policy:",
 	[CCS_MEMORY_AUDIT]      = "audit log:",
 	[CCS_MEMORY_QUERY]      = "query message:",
+#ifdef CONFIG_CCSECURITY_NETWORK
+	[CCS_MEMORY_SOCKET]     = "socket cache:",
+#endif
+};
+
+#ifdef CONFIG_CCSECURITY_LATENCY
+/* String table for /proc/ccs/latency interface. */
+static const char * const ccs_latency_keyword[CCS_MAX_LATENCY] = {
+	[CCS_LATENCY_BPRM_CHECK]         = "bprm_check_security",
+	[CCS_LATENCY_FILE_OPEN]          = "file_open",
+	[CCS_LATENCY_FILE_FCNTL]         = "file_fcntl",
+	[CCS_LATENCY_FILE_IOCTL]         = "file_ioctl",
+	[CCS_LATENCY_INODE_GETATTR]      = "inode_getattr",
+	[CCS_LATENCY_INODE_SETATTR]      = "inode_setattr",
+	[CCS_LATENCY_CHOWN]              = "path_chown",
+	[CCS_LATENCY_CHMOD]              = "path_chmod",
+	[CCS_LATENCY_CHROOT]             = "path_chroot",
+	[CCS_LATENCY_TRUNCATE]           = "path_truncate",
+	[CCS_LATENCY_MKNOD]              = "path_mknod",
+	[CCS_LATENCY_MKDIR]              = "path_mkdir",
+	[CCS_LATENCY_RMDIR]              = "path_rmdir",
+	[CCS_LATENCY_UNLINK]             = "path_unlink",
+	[CCS_LATENCY_SYMLINK]            = "path_symlink",
+	[CCS_LATENCY_RENAME]             = "path_rename",
+	[CCS_LATENCY_LINK]               = "path_link",
+	[CCS_LATENCY_SB_MOUNT]           = "sb_mount",
+	[CCS_LATENCY_SB_UMOUNT]          = "sb_umount",
+	[CCS_LATENCY_SB_PIVOTROOT]       = "sb_pivotroot",
+	[CCS_LATENCY_SOCKET_BIND]        = "socket_bind",
+	[CCS_LATENCY_SOCKET_CONNECT]     = "socket_connect",
+	[CCS_LATENCY_SOCKET_LISTEN]      = "socket_listen",
+	[CCS_LATENCY_SOCKET_ACCEPT]      = "socket_accept",
+	[CCS_LATENCY_SOCKET_SENDMSG]     = "socket_sendmsg",
+	[CCS_LATENCY_SOCKET_RECVMSG]     = "socket_recvmsg",
+	[CCS_LATENCY_SOCKET_GETSOCKNAME] = "socket_getsockname",
+	[CCS_LATENCY_SOCKET_GETPEERNAME] = "socket_getpeername",
+	[CCS_LATENCY_SOCKET_GETSOCKOPT]  = "socket_getsockopt",
+	[CCS_LATENCY_SOCKET_SETSOCKOPT]  = "socket_setsockopt",
+	[CCS_LATENCY_SOCKET_SHUTDOWN]    = "socket_shutdown",
+	[CCS_LATENCY_REALPATH]           = "phase realpath",
+	[CCS_LATENCY_ACL]                = "phase acl",
+	[CCS_LATENCY_AUDIT]              = "phase audit",
 };
+#endif
+
+/* Size of hash table for "struct ccs_dedup_index". */
+#define CCS_DEDUP_HASH_BITS 6
+#define CCS_MAX_DEDUP_HASH (1u << CCS_DEDUP_HASH_BITS)
+
+/* Lists with fewer entries than this are searched without an index. */
+#define CCS_DEDUP_INDEX_MIN 64
 
 /***** SECTION2: Structure definition *****/
 
@@ -399,6 +463,31 @@ struct ccs_log {
 	int size;
 };
 
+/*
+ * Structure for finding an entry with the same content as a new entry without
+ * walking the whole list. Protected by ccs_policy_lock mutex.
+ */
+struct ccs_dedup_index {
+	struct list_head list;
+	/* The list which this index is for. */
+	const struct list_head *owner;
+	/* Size of each entry in bytes. */
+	int size;
+	/* Type of entries. Used only if @is_acl is true. */
+	u8 type;
+	/* True if "struct ccs_acl_info", false if "struct ccs_acl_head". */
+	bool is_acl;
+	/* Number of used slots. */
+	unsigned int count;
+	/* Number of slots - 1. */
+	unsigned int mask;
+	/*
+	 * Open addressing hash table of entries. Allocated by
+	 * ccs_alloc_dedup_slots().
+	 */
+	struct list_head **slot;
+};
+
 /***** SECTION3: Prototype definition section *****/
 
 int ccs_audit_log(struct ccs_request_info *r);
@@ -409,9 +498,15 @@ void ccs_transition_failed(const char *domainname);
 void ccs_write_log(struct ccs_request_info *r, const char *fmt, ...);
 
 static bool ccs_correct_domain(const unsigned char *domainname);
+static bool ccs_compile_condition(struct ccs_condition *cond);
+static bool ccs_condition_constant(const u8 index,
+				   const struct ccs_number_union *ptr,
+				   unsigned long value[2]);
 static bool ccs_correct_path(const char *filename);
 static bool ccs_correct_word(const char *string);
 static bool ccs_correct_word2(const char *string, size_t len);
+static bool ccs_dedup_insert(struct ccs_dedup_index *index,
+			     struct list_head *element);
 static bool ccs_domain_def(const unsigned char *buffer);
 static bool ccs_domain_quota_ok(struct ccs_request_info *r);
 static bool ccs_flush(struct ccs_io_buffer *head);
@@ -439,6 +534,14 @@ static bool ccs_read_group(struct ccs_io_buffer *head, const int idx);
 static bool ccs_read_policy(struct ccs_io_buffer *head, const int idx);
 static bool ccs_same_condition(const struct ccs_condition *a,
 			       const struct ccs_condition *b);
+static bool ccs_dedup_skip(const struct list_head *element,
+			   const bool is_acl);
+static bool ccs_same_entry(const struct list_head *a,
+			   const struct list_head *b, const int size,
+			   const bool is_acl);
+static bool ccs_settle_txn(struct ccs_policy_namespace *ns,
+			   struct list_head *list, const bool is_acl,
+			   const bool commit);
 static bool ccs_select_domain(struct ccs_io_buffer *head, const char *data);
 static bool ccs_set_lf(struct ccs_io_buffer *head);
 static bool ccs_str_starts(char **src, const char *find);
@@ -446,8 +549,7 @@ static char *ccs_get_transit_preference(struct ccs_acl_param *param,
 					struct ccs_condition *e);
 static char *ccs_init_log(struct ccs_request_info *r, int len, const char *fmt,
 			  va_list args);
-static char *ccs_print_bprm(struct linux_binprm *bprm,
-			    struct ccs_page_dump *dump);
+static char *ccs_print_bprm(struct ccs_execve *ee);
 static char *ccs_print_header(struct ccs_request_info *r);
 static char *ccs_read_token(struct ccs_acl_param *param);
 static const char *ccs_yesno(const unsigned int value);
@@ -455,7 +557,9 @@ static const struct ccs_path_info *ccs_get_domainname
 (struct ccs_acl_param *param);
 static const struct ccs_path_info *ccs_get_dqword(char *start);
 static int __init ccs_init_module(void);
+static int ccs_begin_txn(struct ccs_io_buffer *head);
 static int ccs_delete_domain(char *domainname);
+static int ccs_end_txn(struct ccs_io_buffer *head, const bool commit);
 static int ccs_open(struct inode *inode, struct file *file);
 static int ccs_parse_policy(struct ccs_io_buffer *head, char *line);
 static int ccs_release(struct inode *inode, struct file *file);
@@ -469,7 +573,7 @@ static int ccs_update_manager_entry(const char *manager, const bool is_delete);
 static int ccs_update_policy(const int size, struct ccs_acl_param *param);
 static int ccs_write_acl(struct ccs_policy_namespace *ns,
 			 struct list_head *list, char *data,
-			 const bool is_delete);
+			 const bool is_delete, const bool txn);
 static int ccs_write_aggregator(struct ccs_acl_param *param);
 static int ccs_write_answer(struct ccs_io_buffer *head);
 static int ccs_write_domain(struct ccs_io_buffer *head);
@@ -484,6 +588,7 @@ static int ccs_write_task(struct ccs_acl_param *param);
 static int ccs_write_transition_control(struct ccs_acl_param *param,
 					const u8 type);
 static s8 ccs_find_yesno(const char *string, const char *find);
+static s8 ccs_txn_state(const s8 is_deleted, const bool is_delete);
 static ssize_t ccs_read(struct file *file, char __user *buf, size_t count,
 			loff_t *ppos);
 static ssize_t ccs_read_self(struct file *file, char __user *buf, size_t count,
@@ -492,6 +597,10 @@ static ssize_t ccs_write(struct file *file, const char __user *buf,
 			 size_t count, loff_t *ppos);
 static struct ccs_condition *ccs_commit_condition(struct ccs_condition *entry);
 static struct ccs_condition *ccs_get_condition(struct ccs_acl_param *param);
+static struct ccs_dedup_index *ccs_find_dedup_index
+(const struct list_head *list, const u8 type, const bool is_acl);
+static struct ccs_domain_info *__ccs_assign_domain(const char *domainname,
+						   const bool transit);
 static struct ccs_domain_info *ccs_find_domain(const char *domainname);
 static struct ccs_domain_info *ccs_find_domain_by_qid(unsigned int serial);
 static struct ccs_group *ccs_get_group(struct ccs_acl_param *param,
@@ -503,9 +612,19 @@ static struct ccs_policy_namespace *ccs_find_namespace(const char *name,
 static struct ccs_profile *ccs_assign_profile(struct ccs_policy_namespace *ns,
 					      const unsigned int profile);
 static struct ccs_profile *ccs_profile(const u8 profile);
+static u32 ccs_dedup_hash(const struct list_head *element, const int size,
+			  const bool is_acl);
+static u8 ccs_profile_config(const struct ccs_profile *p, const u8 index);
+static u8 ccs_condition_op_cost(const struct ccs_condition_op *op);
+static u8 ccs_condition_stat_mask(const u8 index);
 static u8 ccs_condition_type(const char *word);
 static u8 ccs_make_byte(const u8 c1, const u8 c2, const u8 c3);
 static u8 ccs_parse_ulong(unsigned long *result, char **str);
+static struct list_head **ccs_alloc_dedup_slots(const unsigned int slots);
+static struct list_head *ccs_find_duplicate(struct list_head *list,
+					    struct list_head *element,
+					    const int size,
+					    const bool is_acl);
 static unsigned int ccs_poll(struct file *file, poll_table *wait);
 static void __init ccs_create_entry(const char *name, const umode_t mode,
 				    struct proc_dir_entry *parent,
@@ -513,12 +632,24 @@ static void __init ccs_create_entry(const char *name, const umode_t mode,
 static void __init ccs_load_builtin_policy(void);
 static void __init ccs_policy_io_init(void);
 static void __init ccs_proc_init(void);
+static void ccs_acl_modified(void);
 static void ccs_add_entry(char *header);
 static void ccs_addprintf(char *buffer, int len, const char *fmt, ...)
 	__printf(3, 4);
 static void ccs_addprintf(char *buffer, int len, const char *fmt, ...);
+static void ccs_build_dedup_index(struct list_head *list, const int size,
+				  const u8 type, const bool is_acl,
+				  const unsigned int count);
+static void ccs_check_hooks(void);
 static void ccs_check_profile(void);
 static void ccs_convert_time(time_t time, struct ccs_time *stamp);
+static void ccs_dedup_add(struct list_head *list, struct list_head *element,
+			  const u8 type, const bool is_acl);
+static void ccs_dedup_put(struct ccs_dedup_index *index,
+			  struct list_head *element);
+static void ccs_free_dedup_index(struct ccs_dedup_index *index);
+static void ccs_free_dedup_slots(struct list_head **slot,
+				 const unsigned int slots);
 static void ccs_init_policy_namespace(struct ccs_policy_namespace *ns);
 static void ccs_io_printf(struct ccs_io_buffer *head, const char *fmt, ...)
 	__printf(2, 3);
@@ -556,6 +687,7 @@ static void ccs_write_log2(struct ccs_request_info *r, int len,
 
 #ifdef CONFIG_CCSECURITY_PORTRESERVE
 static bool __ccs_lport_reserved(const u16 port);
+static int ccs_set_reserved_ports(void);
 static int ccs_write_reserved_port(struct ccs_acl_param *param);
 #endif
 
@@ -589,6 +721,17 @@ static ssize_t ccs_write_self(struct file *file, const char __user *buf,
 			      size_t count, loff_t *ppos);
 #endif
 
+#ifdef CONFIG_CCSECURITY_LATENCY
+static int ccs_write_latency(struct ccs_io_buffer *head);
+static void ccs_read_latency(struct ccs_io_buffer *head);
+#endif
+
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+static int ccs_write_acl_profile(struct ccs_io_buffer *head);
+static void ccs_print_acl_counter(struct ccs_io_buffer *head,
+				  const struct ccs_acl_info *acl);
+#endif
+
 /***** SECTION4: Standalone functions section *****/
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 25)
@@ -1203,8 +1346,59 @@ static bool ccs_namespace_enabled;
 /* Initial namespace.*/
 static struct ccs_policy_namespace ccs_kernel_namespace;
 
-/* List of "struct ccs_condition". */
-LIST_HEAD(ccs_condition_list);
+/* Hash table of "struct ccs_condition". See ccs_commit_condition(). */
+struct list_head ccs_condition_list[CCS_MAX_CONDITION_HASH];
+
+/* Counter which is incremented whenever ACL entries are modified. */
+unsigned int ccs_acl_generation;
+
+/*
+ * The "struct ccs_io_buffer" which began a transaction which is not yet
+ * committed or aborted. Protected by ccs_policy_lock mutex.
+ */
+static struct ccs_io_buffer *ccs_txn_owner;
+
+/*
+ * True if the transaction in the slot was committed and the garbage collector
+ * has not yet waited for readers which might be checking CCS_TXN_* states.
+ */
+bool ccs_txn_committed[CCS_TXN_SLOTS];
+
+/*
+ * Bitmask of slots whose transactions were committed or aborted and the
+ * garbage collector has not yet waited for readers which might be checking
+ * CCS_TXN_* states. Protected by ccs_policy_lock mutex.
+ */
+u8 ccs_txn_busy;
+
+/* Slot of the current or last transaction. Protected by ccs_policy_lock. */
+u8 ccs_txn_slot;
+
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+/* Update "struct ccs_acl_counter"? Toggled via /proc/ccs/acl_profile . */
+bool ccs_acl_profiling;
+#endif
+
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+/*
+ * True while "task auto_domain_transition" entries might exist. Checks which
+ * skip ccs_init_request_info() are disabled while true, for it might have to
+ * transit to another domain. Set by ccs_update_acl() before such an entry
+ * becomes visible, and recomputed by the garbage collector after deleted ACL
+ * entries are collected. Protected by ccs_policy_lock for writing.
+ */
+bool ccs_auto_transition_used;
+#endif
+
+#ifdef CONFIG_CCSECURITY_LATENCY
+/* Record latencies? Toggled via /proc/ccs/latency . */
+DEFINE_STATIC_KEY_FALSE(ccs_latency_enabled);
+/* Histograms. Allocated when /proc/ccs/latency is enabled at first. */
+static struct ccs_latency_histogram __percpu *ccs_latency_data;
+#endif
+
+/* Hash table of "struct ccs_dedup_index", keyed by the indexed list. */
+static struct list_head ccs_dedup_index_list[CCS_MAX_DEDUP_HASH];
 
 #ifdef CONFIG_CCSECURITY_PORTRESERVE
 /* Bitmap for reserved local port numbers.*/
@@ -1237,11 +1431,8 @@ static DEFINE_SPINLOCK(ccs_log_lock);
 /* Length of "stuct list_head ccs_log". */
 static unsigned int ccs_log_count;
 
-/* Timestamp counter for last updated. */
-static unsigned int ccs_stat_updated[CCS_MAX_POLICY_STAT];
-
-/* Counter for number of updates. */
-static unsigned int ccs_stat_modified[CCS_MAX_POLICY_STAT];
+/* Counters for /proc/ccs/stat interface. */
+DEFINE_PER_CPU(struct ccs_stat_counter, ccs_stat_counter);
 
 /* Operations for /proc/ccs/self_domain interface. */
 static
@@ -1724,6 +1915,138 @@ static bool ccs_same_condition(const struct ccs_condition *a,
 		&& !memcmp(a + 1, b + 1, a->size - sizeof(*a));
 }
 
+/**
+ * ccs_condition_constant - Get value of a condition operand if it is constant.
+ *
+ * @index: One of values in "enum ccs_conditions_index".
+ * @ptr:   Pointer to "struct ccs_number_union" if @index is CCS_NUMBER_UNION.
+ * @value: Pointer to "unsigned long" to store the range of the value.
+ *
+ * Returns true if @index does not depend on the request, false otherwise.
+ */
+static bool ccs_condition_constant(const u8 index,
+				   const struct ccs_number_union *ptr,
+				   unsigned long value[2])
+{
+	unsigned long v;
+	switch (index) {
+	case CCS_NUMBER_UNION:
+		if (ptr->group)
+			return false;
+		value[0] = ptr->values[0];
+		value[1] = ptr->values[1];
+		return true;
+	case CCS_TYPE_IS_SOCKET:
+		v = S_IFSOCK;
+		break;
+	case CCS_TYPE_IS_SYMLINK:
+		v = S_IFLNK;
+		break;
+	case CCS_TYPE_IS_FILE:
+		v = S_IFREG;
+		break;
+	case CCS_TYPE_IS_BLOCK_DEV:
+		v = S_IFBLK;
+		break;
+	case CCS_TYPE_IS_DIRECTORY:
+		v = S_IFDIR;
+		break;
+	case CCS_TYPE_IS_CHAR_DEV:
+		v = S_IFCHR;
+		break;
+	case CCS_TYPE_IS_FIFO:
+		v = S_IFIFO;
+		break;
+	case CCS_MODE_SETUID:
+		v = S_ISUID;
+		break;
+	case CCS_MODE_SETGID:
+		v = S_ISGID;
+		break;
+	case CCS_MODE_STICKY:
+		v = S_ISVTX;
+		break;
+	case CCS_MODE_OWNER_READ:
+		v = S_IRUSR;
+		break;
+	case CCS_MODE_OWNER_WRITE:
+		v = S_IWUSR;
+		break;
+	case CCS_MODE_OWNER_EXECUTE:
+		v = S_IXUSR;
+		break;
+	case CCS_MODE_GROUP_READ:
+		v = S_IRGRP;
+		break;
+	case CCS_MODE_GROUP_WRITE:
+		v = S_IWGRP;
+		break;
+	case CCS_MODE_GROUP_EXECUTE:
+		v = S_IXGRP;
+		break;
+	case CCS_MODE_OTHERS_READ:
+		v = S_IROTH;
+		break;
+	case CCS_MODE_OTHERS_WRITE:
+		v = S_IWOTH;
+		break;
+	case CCS_MODE_OTHERS_EXECUTE:
+		v = S_IXOTH;
+		break;
+	case CCS_TASK_EXECUTE_HANDLER:
+		v = CCS_TASK_IS_EXECUTE_HANDLER;
+		break;
+	default:
+		return false;
+	}
+	value[0] = v;
+	value[1] = v;
+	return true;
+}
+
+/**
+ * ccs_condition_op_cost - Get relative cost of a "struct ccs_condition_op".
+ *
+ * @op: Pointer to "struct ccs_condition_op".
+ *
+ * Returns 0 for operands already in memory, larger values for operands which
+ * need inode lookups, group scans or pathname calculation.
+ */
+static u8 ccs_condition_op_cost(const struct ccs_condition_op *op)
+{
+	switch (op->type) {
+	case CCS_COND_OP_FALSE:
+		return 0;
+	case CCS_COND_OP_NAME:
+		return op->left == CCS_EXEC_REALPATH ? 4 : 3;
+	case CCS_COND_OP_GROUP:
+		return 2;
+	}
+	return (ccs_condition_stat_mask(op->left) |
+		ccs_condition_stat_mask(op->right)) ? 1 : 0;
+}
+
+/**
+ * ccs_condition_stat_mask - Get stat slots a condition keyword refers to.
+ *
+ * @index: One of values in "enum ccs_conditions_index".
+ *
+ * Returns bitmask of "enum ccs_path_stat_index" which ccs_condition() needs
+ * ccs_get_attributes() to fetch for @index.
+ */
+static u8 ccs_condition_stat_mask(const u8 index)
+{
+	if (index >= CCS_PATH1_UID && index <= CCS_PATH1_DEV_MINOR)
+		return 1 << CCS_PATH1;
+	if (index >= CCS_PATH2_UID && index <= CCS_PATH2_DEV_MINOR)
+		return 1 << CCS_PATH2;
+	if (index >= CCS_PATH1_PARENT_UID && index <= CCS_PATH1_PARENT_PERM)
+		return 1 << CCS_PATH1_PARENT;
+	if (index >= CCS_PATH2_PARENT_UID && index <= CCS_PATH2_PARENT_PERM)
+		return 1 << CCS_PATH2_PARENT;
+	return 0;
+}
+
 /**
  * ccs_condition_type - Get condition type.
  *
@@ -1742,6 +2065,147 @@ static u8 ccs_condition_type(const char *word)
 	return i;
 }
 
+/**
+ * ccs_compile_condition - Compile "struct ccs_condition" into a program.
+ *
+ * @cond: Pointer to "struct ccs_condition".
+ *
+ * Returns true on success, false otherwise.
+ *
+ * Comparisons whose operands are both constant are folded, and the remaining
+ * comparisons are ordered cheapest first. Since every comparison must match,
+ * the order does not change the result. argv[] and envp[] are checked by
+ * ccs_scan_bprm() after the program.
+ */
+static bool ccs_compile_condition(struct ccs_condition *cond)
+{
+	const struct ccs_condition_element *condp =
+		(const struct ccs_condition_element *) (cond + 1);
+	const struct ccs_number_union *numbers_p =
+		(const struct ccs_number_union *) (condp + cond->condc);
+	const struct ccs_name_union *names_p =
+		(const struct ccs_name_union *)
+		(numbers_p + cond->numbers_count);
+	struct ccs_condition_op *ops;
+	u16 opc = 0;
+	u16 i;
+	if (!cond->condc)
+		return true;
+	ops = kzalloc(cond->condc * sizeof(*ops), CCS_GFP_FLAGS);
+	if (!ops)
+		return false;
+	for (i = 0; i < cond->condc; i++, condp++) {
+		struct ccs_condition_op *op = &ops[opc];
+		const u8 left = condp->left;
+		const u8 right = condp->right;
+		unsigned long l[2] = { 0, 0 };
+		unsigned long r[2] = { 0, 0 };
+		bool left_const;
+		bool right_const;
+		if (left == CCS_ARGV_ENTRY || left == CCS_ENVP_ENTRY)
+			continue;
+		op->left = left;
+		op->right = right;
+		op->equals = condp->equals;
+		if (right == CCS_NAME_UNION) {
+			op->type = CCS_COND_OP_NAME;
+			op->ptr = names_p++;
+			opc++;
+			continue;
+		}
+		left_const = ccs_condition_constant(left, numbers_p, l);
+		if (left == CCS_NUMBER_UNION)
+			numbers_p++;
+		if (right == CCS_NUMBER_UNION) {
+			const struct ccs_number_union *ptr = numbers_p++;
+			if (ptr->group) {
+				op->type = CCS_COND_OP_GROUP;
+				op->ptr = ptr->group;
+				if (left_const) {
+					op->left = CCS_NUMBER_UNION;
+					op->values[0] = l[0];
+					op->values[1] = l[1];
+				}
+			} else if (left_const) {
+				if ((l[0] <= ptr->values[1] &&
+				     l[1] >= ptr->values[0]) == op->equals)
+					continue;
+				goto never;
+			} else {
+				op->type = CCS_COND_OP_RANGE;
+				op->values[0] = ptr->values[0];
+				op->values[1] = ptr->values[1];
+			}
+			opc++;
+			continue;
+		}
+		if (right == CCS_EXEC_REALPATH || right == CCS_SYMLINK_TARGET)
+			goto never;
+		right_const = ccs_condition_constant(right, NULL, r);
+		/*
+		 * Bit operation is valid only when counterpart value
+		 * represents permission.
+		 */
+		if (left >= CCS_MODE_SETUID &&
+		    left <= CCS_MODE_OTHERS_EXECUTE) {
+			if (right != CCS_PATH1_PERM &&
+			    right != CCS_PATH1_PARENT_PERM &&
+			    right != CCS_PATH2_PERM &&
+			    right != CCS_PATH2_PARENT_PERM)
+				goto never;
+			op->type = CCS_COND_OP_BITOP;
+			op->left = right;
+			op->values[0] = l[0];
+		} else if (right >= CCS_MODE_SETUID &&
+			   right <= CCS_MODE_OTHERS_EXECUTE) {
+			if (left != CCS_PATH1_PERM &&
+			    left != CCS_PATH1_PARENT_PERM &&
+			    left != CCS_PATH2_PERM &&
+			    left != CCS_PATH2_PARENT_PERM)
+				goto never;
+			op->type = CCS_COND_OP_BITOP;
+			op->values[0] = r[0];
+		} else if (left_const && right_const) {
+			if ((l[0] <= r[1] && l[1] >= r[0]) == op->equals)
+				continue;
+			goto never;
+		} else if (left_const) {
+			op->type = CCS_COND_OP_RANGE;
+			op->left = right;
+			op->values[0] = l[0];
+			op->values[1] = l[1];
+		} else if (right_const) {
+			op->type = CCS_COND_OP_RANGE;
+			op->values[0] = r[0];
+			op->values[1] = r[1];
+		} else {
+			op->type = CCS_COND_OP_COMPARE;
+		}
+		opc++;
+	}
+	/* Stable insertion sort so that cheap comparisons run first. */
+	for (i = 1; i < opc; i++) {
+		const struct ccs_condition_op tmp = ops[i];
+		const u8 cost = ccs_condition_op_cost(&tmp);
+		u16 j = i;
+		while (j && ccs_condition_op_cost(&ops[j - 1]) > cost) {
+			ops[j] = ops[j - 1];
+			j--;
+		}
+		ops[j] = tmp;
+	}
+	goto out;
+never:
+	/* This condition never matches. */
+	memset(ops, 0, sizeof(*ops));
+	ops->type = CCS_COND_OP_FALSE;
+	opc = 1;
+out:
+	cond->ops = ops;
+	cond->opc = opc;
+	return true;
+}
+
 /**
  * ccs_commit_condition - Commit "struct ccs_condition".
  *
@@ -1751,18 +2215,31 @@ static u8 ccs_condition_type(const char *word)
  *
  * This function merges duplicated entries. This function returns NULL if
  * @entry is not duplicated but memory quota for policy has exceeded.
+ *
+ * Entries are hashed on their body so that only entries in the same bucket
+ * are compared.
  */
 static struct ccs_condition *ccs_commit_condition(struct ccs_condition *entry)
 {
 	struct ccs_condition *ptr;
+	struct list_head *list = &ccs_condition_list
+		[jhash(entry + 1, entry->size - sizeof(*entry),
+		       (u32) (unsigned long) entry->transit) &
+		 (CCS_MAX_CONDITION_HASH - 1)];
 	bool found = false;
+	if (!ccs_compile_condition(entry)) {
+		ccs_warn_oom(__func__);
+		ptr = NULL;
+		found = true;
+		goto out;
+	}
 	if (mutex_lock_interruptible(&ccs_policy_lock)) {
 		dprintk(KERN_WARNING "%u: %s failed\n", __LINE__, __func__);
 		ptr = NULL;
 		found = true;
 		goto out;
 	}
-	list_for_each_entry(ptr, &ccs_condition_list, head.list) {
+	list_for_each_entry(ptr, list, head.list) {
 		if (!ccs_same_condition(ptr, entry) ||
 		    atomic_read(&ptr->head.users) == CCS_GC_IN_PROGRESS)
 			continue;
@@ -1772,9 +2249,10 @@ static struct ccs_condition *ccs_commit_condition(struct ccs_condition *entry)
 		break;
 	}
 	if (!found) {
-		if (ccs_memory_ok(entry, entry->size)) {
+		if (ccs_memory_ok(entry, entry->size + entry->opc *
+				  sizeof(struct ccs_condition_op))) {
 			atomic_set(&entry->head.users, 1);
-			list_add(&entry->head.list, &ccs_condition_list);
+			list_add(&entry->head.list, list);
 		} else {
 			found = true;
 			ptr = NULL;
@@ -2112,6 +2590,8 @@ store_value:
 		if (!condp) {
 			dprintk(KERN_WARNING "%u: dry_run left=%u right=%u "
 				"match=%u\n", __LINE__, left, right, !is_not);
+			e.stat_mask |= ccs_condition_stat_mask(left) |
+				ccs_condition_stat_mask(right);
 			continue;
 		}
 		condp->left = left;
@@ -2449,6 +2929,7 @@ static void ccs_check_profile(void)
 		panic("STOP!");
 	}
 	ccs_read_unlock(idx);
+	ccs_check_hooks();
 	printk(KERN_INFO "Mandatory Access Control activated.\n");
 }
 
@@ -2484,12 +2965,22 @@ static struct ccs_profile *ccs_profile(const u8 profile)
  */
 u8 ccs_get_config(const u8 profile, const u8 index)
 {
-	u8 config;
-	const struct ccs_profile *p;
 	if (!ccs_policy_loaded)
 		return CCS_CONFIG_DISABLED;
-	p = ccs_profile(profile);
-	config = p->config[index];
+	return ccs_profile_config(ccs_profile(profile), index);
+}
+
+/**
+ * ccs_profile_config - Get config for specified functionality in the given profile.
+ *
+ * @p:     Pointer to "struct ccs_profile".
+ * @index: Index number of functionality.
+ *
+ * Returns config.
+ */
+static u8 ccs_profile_config(const struct ccs_profile *p, const u8 index)
+{
+	u8 config = p->config[index];
 	if (config == CCS_CONFIG_USE_DEFAULT)
 		config = p->config[ccs_index2category[index]
 				   + CCS_MAX_MAC_INDEX];
@@ -2498,6 +2989,64 @@ u8 ccs_get_config(const u8 profile, const u8 index)
 	return config;
 }
 
+/**
+ * ccs_check_hooks - Enable only LSM hooks which some profile needs.
+ *
+ * Returns nothing.
+ *
+ * Hooks for getattr, ioctl and network operations are called very frequently
+ * but are no-op unless some profile enables the functionality. Therefore,
+ * we let such hooks return immediately while all profiles in all namespaces
+ * have them disabled.
+ */
+static void ccs_check_hooks(void)
+{
+	static DEFINE_MUTEX(lock);
+	struct ccs_policy_namespace *ns;
+	u8 groups = 0;
+	int idx;
+	mutex_lock(&lock);
+	idx = ccs_read_lock();
+	if (!ccs_policy_loaded)
+		goto out;
+	list_for_each_entry_srcu(ns, &ccs_namespace_list, namespace_list,
+				 &ccs_ss) {
+		unsigned int profile;
+		for (profile = 0; profile < CCS_MAX_PROFILES; profile++) {
+			const struct ccs_profile *p = ns->profile_ptr[profile];
+			u8 i;
+			if (!p)
+				continue;
+			for (i = 0; i < CCS_MAX_MAC_INDEX; i++) {
+				if ((ccs_profile_config(p, i) &
+				     (CCS_CONFIG_MAX_MODE - 1)) ==
+				    CCS_CONFIG_DISABLED)
+					continue;
+				switch (i) {
+#ifdef CONFIG_CCSECURITY_FILE_GETATTR
+				case CCS_MAC_FILE_GETATTR:
+					groups |= 1 << CCS_HOOK_FILE_GETATTR;
+					break;
+#endif
+				case CCS_MAC_FILE_IOCTL:
+					groups |= 1 << CCS_HOOK_FILE_IOCTL;
+					break;
+#ifdef CONFIG_CCSECURITY_NETWORK
+				default:
+					if (ccs_index2category[i] ==
+					    CCS_MAC_CATEGORY_NETWORK)
+						groups |= 1 << CCS_HOOK_NETWORK;
+#endif
+				}
+			}
+		}
+	}
+out:
+	ccs_read_unlock(idx);
+	ccs_update_hooks(groups);
+	mutex_unlock(&lock);
+}
+
 /**
  * ccs_find_yesno - Find values for specified keyword.
  *
@@ -2665,6 +3214,7 @@ static int ccs_write_profile(struct ccs_io_buffer *head)
 {
 	char *data = head->write_buf;
 	unsigned int i;
+	int error;
 	char *cp;
 	struct ccs_profile *profile;
 	if (sscanf(data, "PROFILE_VERSION=%u", &head->w.ns->profile_version)
@@ -2700,7 +3250,10 @@ static int ccs_write_profile(struct ccs_io_buffer *head)
 				     ccs_pref_keywords[i]);
 		return 0;
 	}
-	return ccs_set_mode(data, cp, profile);
+	error = ccs_set_mode(data, cp, profile);
+	if (!error)
+		ccs_check_hooks();
+	return error;
 }
 
 /**
@@ -2814,6 +3367,385 @@ next:
 		goto next;
 }
 
+/**
+ * ccs_dedup_hash - Calculate hash value of an entry's content.
+ *
+ * @element: Pointer to "struct list_head".
+ * @size:    Size of the entry in bytes.
+ * @is_acl:  True if @element is in "struct ccs_acl_info", false if @element
+ *           is in "struct ccs_acl_head".
+ *
+ * Returns hash value of fields compared by ccs_same_entry().
+ */
+static u32 ccs_dedup_hash(const struct list_head *element, const int size,
+			  const bool is_acl)
+{
+	if (is_acl) {
+		const struct ccs_acl_info *acl =
+			container_of(element, typeof(*acl), list);
+		return jhash(acl + 1, size - sizeof(*acl),
+			     (u32) (unsigned long) acl->cond);
+	} else {
+		const struct ccs_acl_head *head =
+			container_of(element, typeof(*head), list);
+		return jhash(head + 1, size - sizeof(*head), 0);
+	}
+}
+
+/**
+ * ccs_same_entry - Check whether two entries can be merged.
+ *
+ * @a:      Pointer to "struct list_head".
+ * @b:      Pointer to "struct list_head".
+ * @size:   Size of the entries in bytes.
+ * @is_acl: True if @a and @b are in "struct ccs_acl_info", false if @a and
+ *          @b are in "struct ccs_acl_head".
+ *
+ * Returns true if @a and @b have the same content, false otherwise.
+ */
+static bool ccs_same_entry(const struct list_head *a,
+			   const struct list_head *b, const int size,
+			   const bool is_acl)
+{
+	if (is_acl) {
+		const struct ccs_acl_info *p1 = container_of(a, typeof(*p1),
+							     list);
+		const struct ccs_acl_info *p2 = container_of(b, typeof(*p2),
+							     list);
+		return p1->type == p2->type && p1->cond == p2->cond &&
+			!memcmp(p1 + 1, p2 + 1, size - sizeof(*p1));
+	} else {
+		const struct ccs_acl_head *p1 = container_of(a, typeof(*p1),
+							     list);
+		const struct ccs_acl_head *p2 = container_of(b, typeof(*p2),
+							     list);
+		return !memcmp(p1 + 1, p2 + 1, size - sizeof(*p1));
+	}
+}
+
+/**
+ * ccs_dedup_skip - Check whether an entry must not be merged into.
+ *
+ * @element: Pointer to "struct list_head".
+ * @is_acl:  True if @element is in "struct ccs_acl_info", false if @element
+ *           is in "struct ccs_acl_head".
+ *
+ * Returns true if @element is being kfree()d or is deleted by the current
+ * transaction, false otherwise.
+ */
+static bool ccs_dedup_skip(const struct list_head *element, const bool is_acl)
+{
+	const s8 is_deleted = is_acl ?
+		container_of(element, struct ccs_acl_info, list)->is_deleted :
+		container_of(element, struct ccs_acl_head, list)->is_deleted;
+	return is_deleted == CCS_GC_IN_PROGRESS ||
+		is_deleted == CCS_TXN_DELETED;
+}
+
+/**
+ * ccs_find_dedup_index - Find "struct ccs_dedup_index" for a list.
+ *
+ * @list:   Pointer to "struct list_head".
+ * @type:   Type of entries. Ignored if @is_acl is false.
+ * @is_acl: True if @list holds "struct ccs_acl_info", false otherwise.
+ *
+ * Returns pointer to "struct ccs_dedup_index" if found, NULL otherwise.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static struct ccs_dedup_index *ccs_find_dedup_index
+(const struct list_head *list, const u8 type, const bool is_acl)
+{
+	struct ccs_dedup_index *index;
+	list_for_each_entry(index, &ccs_dedup_index_list
+			    [hash_ptr((void *) list, CCS_DEDUP_HASH_BITS)],
+			    list) {
+		if (index->owner == list && index->is_acl == is_acl &&
+		    (!is_acl || index->type == type))
+			return index;
+	}
+	return NULL;
+}
+
+/**
+ * ccs_free_dedup_index - Release "struct ccs_dedup_index".
+ *
+ * @index: Pointer to "struct ccs_dedup_index".
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_free_dedup_index(struct ccs_dedup_index *index)
+{
+	list_del(&index->list);
+	ccs_free_dedup_slots(index->slot, index->mask + 1);
+	kfree(index);
+}
+
+/**
+ * ccs_forget_dedup_index - Release "struct ccs_dedup_index" for a list.
+ *
+ * @list: Pointer to "struct list_head".
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex. The GC calls this function before
+ * kfree()ing or reinjecting entries of @list, for indexes do not know about
+ * them.
+ */
+void ccs_forget_dedup_index(const struct list_head *list)
+{
+	struct ccs_dedup_index *index;
+	struct ccs_dedup_index *tmp;
+	list_for_each_entry_safe(index, tmp, &ccs_dedup_index_list
+				 [hash_ptr((void *) list, CCS_DEDUP_HASH_BITS)],
+				 list) {
+		if (index->owner == list)
+			ccs_free_dedup_index(index);
+	}
+}
+
+/**
+ * ccs_alloc_dedup_slots - Allocate slots for "struct ccs_dedup_index".
+ *
+ * @slots: Number of slots.
+ *
+ * Returns pointer to zeroed slots on success, NULL otherwise.
+ *
+ * The slots are charged to the policy memory quota.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static struct list_head **ccs_alloc_dedup_slots(const unsigned int slots)
+{
+	const size_t size = slots * sizeof(struct list_head *);
+	struct list_head **slot;
+	if (ccs_memory_quota[CCS_MEMORY_POLICY] &&
+	    ccs_memory_used[CCS_MEMORY_POLICY] + size >
+	    ccs_memory_quota[CCS_MEMORY_POLICY])
+		return NULL;
+	slot = vmalloc(size);
+	if (!slot)
+		return NULL;
+	memset(slot, 0, size);
+	ccs_memory_used[CCS_MEMORY_POLICY] += size;
+	return slot;
+}
+
+/**
+ * ccs_free_dedup_slots - Release slots allocated by ccs_alloc_dedup_slots().
+ *
+ * @slot:  Pointer to slots.
+ * @slots: Number of slots.
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_free_dedup_slots(struct list_head **slot,
+				 const unsigned int slots)
+{
+	ccs_memory_used[CCS_MEMORY_POLICY] -= slots * sizeof(*slot);
+	vfree(slot);
+}
+
+/**
+ * ccs_dedup_put - Store an entry into "struct ccs_dedup_index".
+ *
+ * @index:   Pointer to "struct ccs_dedup_index" which has a free slot.
+ * @element: Pointer to "struct list_head".
+ *
+ * Returns nothing.
+ */
+static void ccs_dedup_put(struct ccs_dedup_index *index,
+			  struct list_head *element)
+{
+	unsigned int i = ccs_dedup_hash(element, index->size, index->is_acl) &
+		index->mask;
+	while (index->slot[i])
+		i = (i + 1) & index->mask;
+	index->slot[i] = element;
+	index->count++;
+}
+
+/**
+ * ccs_dedup_insert - Add an entry to "struct ccs_dedup_index".
+ *
+ * @index:   Pointer to "struct ccs_dedup_index".
+ * @element: Pointer to "struct list_head".
+ *
+ * Returns true on success, false otherwise.
+ *
+ * The table is doubled when it becomes half full.
+ */
+static bool ccs_dedup_insert(struct ccs_dedup_index *index,
+			     struct list_head *element)
+{
+	if ((index->count + 1) * 2 > index->mask + 1) {
+		struct list_head **old = index->slot;
+		const unsigned int old_size = index->mask + 1;
+		unsigned int i;
+		index->slot = ccs_alloc_dedup_slots(old_size * 2);
+		if (!index->slot) {
+			index->slot = old;
+			return false;
+		}
+		index->mask = old_size * 2 - 1;
+		index->count = 0;
+		for (i = 0; i < old_size; i++)
+			if (old[i])
+				ccs_dedup_put(index, old[i]);
+		ccs_free_dedup_slots(old, old_size);
+	}
+	ccs_dedup_put(index, element);
+	return true;
+}
+
+/**
+ * ccs_build_dedup_index - Create "struct ccs_dedup_index" for a list.
+ *
+ * @list:   Pointer to "struct list_head".
+ * @size:   Size of each entry in bytes.
+ * @type:   Type of entries to index. Ignored if @is_acl is false.
+ * @is_acl: True if @list holds "struct ccs_acl_info", false otherwise.
+ * @count:  Number of entries to index.
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex. Failure is not an error, for
+ * ccs_find_duplicate() can walk @list instead.
+ */
+static void ccs_build_dedup_index(struct list_head *list, const int size,
+				  const u8 type, const bool is_acl,
+				  const unsigned int count)
+{
+	struct ccs_dedup_index *index =
+		kzalloc(sizeof(*index), CCS_GFP_FLAGS | __GFP_NOWARN);
+	unsigned int slots = CCS_DEDUP_INDEX_MIN;
+	struct list_head *pos;
+	if (!index)
+		return;
+	while (slots < count * 4)
+		slots <<= 1;
+	index->slot = ccs_alloc_dedup_slots(slots);
+	if (!index->slot) {
+		kfree(index);
+		return;
+	}
+	index->owner = list;
+	index->size = size;
+	index->type = type;
+	index->is_acl = is_acl;
+	index->mask = slots - 1;
+	list_add(&index->list, &ccs_dedup_index_list
+		 [hash_ptr((void *) list, CCS_DEDUP_HASH_BITS)]);
+	list_for_each(pos, list) {
+		if (is_acl && container_of(pos, struct ccs_acl_info, list)->
+		    type != type)
+			continue;
+		if (!ccs_dedup_insert(index, pos)) {
+			ccs_free_dedup_index(index);
+			return;
+		}
+	}
+}
+
+/**
+ * ccs_dedup_add - Add a new entry to "struct ccs_dedup_index" for a list.
+ *
+ * @list:    Pointer to "struct list_head" which @element was appended to.
+ * @element: Pointer to "struct list_head".
+ * @type:    Type of @element. Ignored if @is_acl is false.
+ * @is_acl:  True if @list holds "struct ccs_acl_info", false otherwise.
+ *
+ * Returns nothing.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static void ccs_dedup_add(struct list_head *list, struct list_head *element,
+			  const u8 type, const bool is_acl)
+{
+	struct ccs_dedup_index *index =
+		ccs_find_dedup_index(list, type, is_acl);
+	if (index && !ccs_dedup_insert(index, element))
+		ccs_free_dedup_index(index);
+}
+
+/**
+ * ccs_find_duplicate - Find an entry which a new entry can be merged into.
+ *
+ * @list:    Pointer to "struct list_head" to search.
+ * @element: Pointer to "struct list_head" in the new entry.
+ * @size:    Size of the new entry in bytes.
+ * @is_acl:  True if @list holds "struct ccs_acl_info", false if @list holds
+ *           "struct ccs_acl_head".
+ *
+ * Returns pointer to "struct list_head" in the found entry, NULL otherwise.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ *
+ * Short lists are searched by walking. Once a walk finds no match in a list
+ * with at least CCS_DEDUP_INDEX_MIN entries of the same type, an index is
+ * built so that following searches cost O(1) expected.
+ */
+static struct list_head *ccs_find_duplicate(struct list_head *list,
+					    struct list_head *element,
+					    const int size,
+					    const bool is_acl)
+{
+	const u8 type = is_acl ?
+		container_of(element, struct ccs_acl_info, list)->type : 0;
+	struct ccs_dedup_index *index =
+		ccs_find_dedup_index(list, type, is_acl);
+	unsigned int count = 0;
+	struct list_head *pos;
+	if (index) {
+		unsigned int i = ccs_dedup_hash(element, size, is_acl) &
+			index->mask;
+		for (; (pos = index->slot[i]) != NULL;
+		     i = (i + 1) & index->mask) {
+			if (ccs_dedup_skip(pos, is_acl))
+				continue;
+			if (ccs_same_entry(pos, element, size, is_acl))
+				return pos;
+		}
+		return NULL;
+	}
+	list_for_each(pos, list) {
+		if (is_acl && container_of(pos, struct ccs_acl_info, list)->
+		    type != type)
+			continue;
+		count++;
+		if (ccs_dedup_skip(pos, is_acl))
+			continue;
+		if (ccs_same_entry(pos, element, size, is_acl))
+			return pos;
+	}
+	if (count >= CCS_DEDUP_INDEX_MIN)
+		ccs_build_dedup_index(list, size, type, is_acl, count);
+	return NULL;
+}
+
+/**
+ * ccs_txn_state - Calculate new state of an entry updated by a transaction.
+ *
+ * @is_deleted: Current value. False or true or CCS_TXN_ADDED.
+ * @is_delete:  True if it is a delete request.
+ *
+ * Returns new value.
+ *
+ * An entry which readers can see is marked as CCS_TXN_DELETED rather than
+ * deleted, and an entry which readers cannot see is marked as CCS_TXN_ADDED
+ * rather than revived, so that readers see the change upon commit.
+ */
+static s8 ccs_txn_state(const s8 is_deleted, const bool is_delete)
+{
+	if (!is_deleted)
+		return is_delete ? CCS_TXN_DELETED : false;
+	return is_delete ? true : CCS_TXN_ADDED;
+}
+
 /**
  * ccs_update_policy - Update an entry for exception policy.
  *
@@ -2830,25 +3762,37 @@ static int ccs_update_policy(const int size, struct ccs_acl_param *param)
 	int error = param->is_delete ? -ENOENT : -ENOMEM;
 	struct ccs_acl_head *entry;
 	struct list_head *list = param->list;
+	struct list_head *element;
 	BUG_ON(size < sizeof(*entry));
 	if (mutex_lock_interruptible(&ccs_policy_lock))
 		return -ENOMEM;
-	list_for_each_entry_srcu(entry, list, list, &ccs_ss) {
-		if (entry->is_deleted == CCS_GC_IN_PROGRESS)
-			continue;
-		if (memcmp(entry + 1, new_entry + 1, size - sizeof(*entry)))
-			continue;
-		entry->is_deleted = param->is_delete;
+	if (ccs_txn_owner && !param->txn) {
+		error = -EBUSY;
+		goto out;
+	}
+	element = ccs_find_duplicate(list, &new_entry->list, size, false);
+	if (element) {
+		entry = container_of(element, typeof(*entry), list);
+		if (param->txn)
+			entry->is_deleted = ccs_txn_state(entry->is_deleted,
+							  param->is_delete);
+		else
+			entry->is_deleted = param->is_delete;
+		if (entry->is_deleted == true)
+			ccs_mark_garbage(param->ns, list, false);
 		error = 0;
-		break;
 	}
 	if (error && !param->is_delete) {
+		if (param->txn)
+			new_entry->is_deleted = CCS_TXN_ADDED;
 		entry = ccs_commit_ok(new_entry, size);
 		if (entry) {
 			list_add_tail_rcu(&entry->list, list);
+			ccs_dedup_add(list, &entry->list, 0, false);
 			error = 0;
 		}
 	}
+out:
 	mutex_unlock(&ccs_policy_lock);
 	return error;
 }
@@ -2865,7 +3809,7 @@ static int ccs_update_manager_entry(const char *manager,
 				    const bool is_delete)
 {
 	struct ccs_acl_param param = {
-		/* .ns = &ccs_kernel_namespace, */
+		.ns = &ccs_kernel_namespace,
 		.is_delete = is_delete,
 		.list = &ccs_kernel_namespace.policy_list[CCS_ID_MANAGER],
 	};
@@ -2917,7 +3861,7 @@ static void ccs_read_manager(struct ccs_io_buffer *head)
 			     policy_list[CCS_ID_MANAGER]) {
 		struct ccs_manager *ptr =
 			list_entry(head->r.acl, typeof(*ptr), head.list);
-		if (ptr->head.is_deleted)
+		if (ccs_deleted(ptr->head.is_deleted))
 			continue;
 		if (!ccs_flush(head))
 			return;
@@ -2958,7 +3902,7 @@ static bool ccs_manager(void)
 	list_for_each_entry_srcu(ptr, &ccs_kernel_namespace.
 				 policy_list[CCS_ID_MANAGER], head.list,
 				 &ccs_ss) {
-		if (ptr->head.is_deleted)
+		if (ccs_deleted(ptr->head.is_deleted))
 			continue;
 		if (ccs_pathcmp(domainname, ptr->manager) &&
 		    ccs_pathcmp(&exe, ptr->manager))
@@ -3062,6 +4006,18 @@ static bool ccs_select_domain(struct ccs_io_buffer *head, const char *data)
 	return true;
 }
 
+/**
+ * ccs_acl_modified - Invalidate data derived from ACL entries and groups.
+ *
+ * Returns nothing.
+ */
+static void ccs_acl_modified(void)
+{
+	mutex_lock(&ccs_policy_lock);
+	ccs_acl_generation++;
+	mutex_unlock(&ccs_policy_lock);
+}
+
 /**
  * ccs_update_acl - Update "struct ccs_acl_info" entry.
  *
@@ -3079,6 +4035,8 @@ static int ccs_update_acl(const int size, struct ccs_acl_param *param)
 	int error = is_delete ? -ENOENT : -ENOMEM;
 	struct ccs_acl_info *entry;
 	struct list_head * const list = param->list;
+	struct list_head *element;
+	bool add = !is_delete;
 	BUG_ON(size < sizeof(*entry));
 	if (param->data[0]) {
 		new_entry->cond = ccs_get_condition(param);
@@ -3101,28 +4059,79 @@ static int ccs_update_acl(const int size, struct ccs_acl_param *param)
 	}
 	if (mutex_lock_interruptible(&ccs_policy_lock))
 		return -ENOMEM;
-	list_for_each_entry_srcu(entry, list, list, &ccs_ss) {
-		if (entry->is_deleted == CCS_GC_IN_PROGRESS)
-			continue;
-		if (entry->type != new_entry->type ||
-		    entry->cond != new_entry->cond ||
-		    memcmp(entry + 1, new_entry + 1, size - sizeof(*entry)))
-			continue;
-		if (is_delete)
-			entry->perm &= ~new_entry->perm;
-		else
-			entry->perm |= new_entry->perm;
-		entry->is_deleted = !entry->perm;
+	if (ccs_txn_owner && !param->txn) {
+		error = -EBUSY;
+		goto out;
+	}
+#ifdef CONFIG_CCSECURITY_TASK_DOMAIN_TRANSITION
+	if (new_entry->type == CCS_TYPE_AUTO_TASK_ACL && !is_delete)
+		ccs_auto_transition_used = true;
+#endif
+	element = ccs_find_duplicate(list, &new_entry->list, size, true);
+	if (element) {
+		entry = container_of(element, typeof(*entry), list);
+		add = false;
 		error = 0;
-		break;
+		if (param->txn && entry->is_deleted != CCS_TXN_ADDED) {
+			/*
+			 * Readers must keep seeing old permissions until
+			 * commit. Revive a deleted entry, or replace a live
+			 * entry with a copy which has new permissions.
+			 */
+			u16 perm = entry->is_deleted ? 0 : entry->perm;
+			if (is_delete)
+				perm &= ~new_entry->perm;
+			else
+				perm |= new_entry->perm;
+			if (entry->is_deleted) {
+				entry->perm = perm;
+				if (perm)
+					entry->is_deleted = CCS_TXN_ADDED;
+			} else if (perm != entry->perm) {
+				entry->is_deleted = CCS_TXN_DELETED;
+				new_entry->perm = perm;
+				add = perm != 0;
+				if (add)
+					error = -ENOMEM;
+			}
+		} else {
+			if (is_delete)
+				entry->perm &= ~new_entry->perm;
+			else
+				entry->perm |= new_entry->perm;
+			entry->is_deleted = !entry->perm;
+			if (!entry->is_deleted && param->txn)
+				entry->is_deleted = CCS_TXN_ADDED;
+		}
+		if (entry->is_deleted == true)
+			ccs_mark_garbage(param->ns, list, true);
 	}
-	if (error && !is_delete) {
+	if (add) {
+		if (param->txn)
+			new_entry->is_deleted = CCS_TXN_ADDED;
 		entry = ccs_commit_ok(new_entry, size);
 		if (entry) {
+#ifdef CONFIG_CCSECURITY_HOT_ACL
+			entry->hits = alloc_percpu(u32);
+#endif
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+			entry->profile = alloc_percpu(struct ccs_acl_counter);
+#endif
 			list_add_tail_rcu(&entry->list, list);
+			ccs_dedup_add(list, &entry->list, entry->type, true);
 			error = 0;
+		} else if (element) {
+			container_of(element, typeof(*entry), list)->
+				is_deleted = false;
 		}
 	}
+	if (!error) {
+		ccs_acl_generation++;
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+		ccs_touch_acl_list(param->ns, list);
+#endif
+	}
+out:
 	mutex_unlock(&ccs_policy_lock);
 	return error;
 }
@@ -3439,6 +4448,7 @@ static int ccs_write_capability(struct ccs_acl_param *param)
  * @list:      Pointer to "struct list_head".
  * @data:      Policy to be interpreted.
  * @is_delete: True if it is a delete request.
+ * @txn:       True if it is a part of a transaction.
  *
  * Returns 0 on success, negative value otherwise.
  *
@@ -3446,13 +4456,14 @@ static int ccs_write_capability(struct ccs_acl_param *param)
  */
 static int ccs_write_acl(struct ccs_policy_namespace *ns,
 			 struct list_head *list, char *data,
-			 const bool is_delete)
+			 const bool is_delete, const bool txn)
 {
 	struct ccs_acl_param param = {
 		.ns = ns,
 		.list = list,
 		.data = data,
 		.is_delete = is_delete,
+		.txn = txn,
 	};
 	static const struct {
 		const char *keyword;
@@ -3513,6 +4524,7 @@ static int ccs_delete_domain(char *domainname)
 		    ccs_pathcmp(domain->domainname, &name))
 			continue;
 		domain->is_deleted = true;
+		set_bit(CCS_GC_DIRTY_DOMAIN, &ccs_gc_dirty);
 		break;
 	}
 	mutex_unlock(&ccs_policy_lock);
@@ -3563,6 +4575,7 @@ static int ccs_write_domain(struct ccs_io_buffer *head)
 			set_bit(idx, domain->group);
 		else
 			clear_bit(idx, domain->group);
+		ccs_acl_modified();
 		return 0;
 	}
 	for (idx = 0; idx < CCS_MAX_DOMAIN_INFO_FLAGS; idx++) {
@@ -3572,7 +4585,8 @@ static int ccs_write_domain(struct ccs_io_buffer *head)
 		domain->flags[idx] = !is_delete;
 		return 0;
 	}
-	return ccs_write_acl(ns, &domain->acl_info_list, data, is_delete);
+	return ccs_write_acl(ns, &domain->acl_info_list, data, is_delete,
+			     ccs_txn_owner == head);
 }
 
 /**
@@ -3806,7 +4820,6 @@ static bool ccs_print_condition(struct ccs_io_buffer *head,
 			ccs_set_string(head, name);
 			ccs_set_string(head, "\"");
 		}
-		ccs_set_lf(head);
 		return true;
 	}
 	return false;
@@ -3829,6 +4842,55 @@ static void ccs_set_group(struct ccs_io_buffer *head, const char *category)
 	ccs_set_string(head, category);
 }
 
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+
+/**
+ * ccs_print_acl_counter - Print "struct ccs_acl_counter".
+ *
+ * @head: Pointer to "struct ccs_io_buffer".
+ * @acl:  Pointer to "struct ccs_acl_info".
+ *
+ * Returns nothing.
+ *
+ * Counters of all CPUs are summed up without locks. Thus, the result might
+ * be slightly behind the latest state. Counters of the condition part are
+ * per entry, for a condition is shared by entries with the same condition.
+ */
+static void ccs_print_acl_counter(struct ccs_io_buffer *head,
+				  const struct ccs_acl_info *acl)
+{
+	struct ccs_acl_counter sum = { };
+	int cpu;
+	if (!acl->profile)
+		return;
+	for_each_possible_cpu(cpu) {
+		const struct ccs_acl_counter *counter =
+			per_cpu_ptr(acl->profile, cpu);
+		sum.entry.evaluated += counter->entry.evaluated;
+		sum.entry.matched += counter->entry.matched;
+		sum.entry.cycles += counter->entry.cycles;
+		sum.cond.evaluated += counter->cond.evaluated;
+		sum.cond.matched += counter->cond.matched;
+		sum.cond.cycles += counter->cond.cycles;
+		sum.indexed += counter->indexed;
+	}
+	ccs_io_printf(head, " evaluated=%llu matched=%llu cycles=%llu",
+		      (unsigned long long) sum.entry.evaluated,
+		      (unsigned long long) sum.entry.matched,
+		      (unsigned long long) sum.entry.cycles);
+	if (acl->cond)
+		ccs_io_printf(head, " condition.evaluated=%llu"
+			      " condition.matched=%llu condition.cycles=%llu",
+			      (unsigned long long) sum.cond.evaluated,
+			      (unsigned long long) sum.cond.matched,
+			      (unsigned long long) sum.cond.cycles);
+	else
+		ccs_io_printf(head, " indexed=%llu",
+			      (unsigned long long) sum.indexed);
+}
+
+#endif
+
 /**
  * ccs_print_entry - Print an ACL entry.
  *
@@ -3846,7 +4908,7 @@ static bool ccs_print_entry(struct ccs_io_buffer *head,
 	u8 bit;
 	if (head->r.print_cond_part)
 		goto print_cond_part;
-	if (acl->is_deleted)
+	if (ccs_deleted(acl->is_deleted))
 		return true;
 	if (!ccs_flush(head))
 		return false;
@@ -4044,9 +5106,14 @@ print_cond_part:
 		if (!ccs_print_condition(head, acl->cond))
 			return false;
 		head->r.print_cond_part = false;
-	} else {
-		ccs_set_lf(head);
 	}
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+	if (head->type == CCS_ACL_PROFILE) {
+		ccs_set_string(head, " #");
+		ccs_print_acl_counter(head, acl);
+	}
+#endif
+	ccs_set_lf(head);
 	return true;
 }
 
@@ -4248,6 +5315,8 @@ static int ccs_write_group(struct ccs_acl_param *param, const u8 type)
 		error = ccs_update_policy(sizeof(*e), param);
 #endif
 	}
+	if (!error)
+		ccs_acl_modified();
 out:
 	ccs_put_group(group);
 	return error;
@@ -4281,7 +5350,6 @@ static int ccs_write_reserved_port(struct ccs_acl_param *param)
 	struct ccs_reserved *e = &param->e.reserved;
 	struct ccs_policy_namespace *ns = param->ns;
 	int error;
-	u8 *tmp;
 	if (param->data[0] == '@' ||
 	    !ccs_parse_number_union(param, &e->port) ||
 	    e->port.values[1] > 65535 || param->data[0])
@@ -4290,7 +5358,20 @@ static int ccs_write_reserved_port(struct ccs_acl_param *param)
 	error = ccs_update_policy(sizeof(*e), param);
 	if (error)
 		return error;
-	tmp = kzalloc(sizeof(ccs_reserved_port_map), CCS_GFP_FLAGS);
+	return ccs_set_reserved_ports();
+}
+
+/**
+ * ccs_set_reserved_ports - Rebuild ccs_reserved_port_map from policy.
+ *
+ * Returns 0 on success, negative value otherwise.
+ *
+ * Caller holds ccs_read_lock().
+ */
+static int ccs_set_reserved_ports(void)
+{
+	struct ccs_policy_namespace *ns;
+	u8 *tmp = kzalloc(sizeof(ccs_reserved_port_map), CCS_GFP_FLAGS);
 	if (!tmp)
 		return -ENOMEM;
 	list_for_each_entry_srcu(ns, &ccs_namespace_list, namespace_list,
@@ -4299,7 +5380,7 @@ static int ccs_write_reserved_port(struct ccs_acl_param *param)
 		struct list_head *list = &ns->policy_list[CCS_ID_RESERVEDPORT];
 		list_for_each_entry_srcu(ptr, list, head.list, &ccs_ss) {
 			unsigned int port;
-			if (ptr->head.is_deleted)
+			if (ccs_deleted(ptr->head.is_deleted))
 				continue;
 			for (port = ptr->port.values[0];
 			     port <= ptr->port.values[1]; port++)
@@ -4408,6 +5489,7 @@ static int ccs_write_exception(struct ccs_io_buffer *head)
 	struct ccs_acl_param param = {
 		.ns = head->w.ns,
 		.is_delete = is_delete,
+		.txn = ccs_txn_owner == head,
 		.data = head->write_buf,
 	};
 	u8 i;
@@ -4432,7 +5514,7 @@ static int ccs_write_exception(struct ccs_io_buffer *head)
 		if (group < CCS_MAX_ACL_GROUPS && *data++ == ' ')
 			return ccs_write_acl(head->w.ns,
 					     &head->w.ns->acl_group[group],
-					     data, is_delete);
+					     data, is_delete, param.txn);
 	}
 	return -EINVAL;
 }
@@ -4458,7 +5540,7 @@ static bool ccs_read_group(struct ccs_io_buffer *head, const int idx)
 		list_for_each_cookie(head->r.acl, &group->member_list) {
 			struct ccs_acl_head *ptr =
 				list_entry(head->r.acl, typeof(*ptr), list);
-			if (ptr->is_deleted)
+			if (ccs_deleted(ptr->is_deleted))
 				continue;
 			if (!ccs_flush(head))
 				return false;
@@ -4511,7 +5593,7 @@ static bool ccs_read_policy(struct ccs_io_buffer *head, const int idx)
 	list_for_each_cookie(head->r.acl, list) {
 		struct ccs_acl_head *acl =
 			container_of(head->r.acl, typeof(*acl), list);
-		if (acl->is_deleted)
+		if (ccs_deleted(acl->is_deleted))
 			continue;
 		if (head->r.print_transition_related_only &&
 		    idx != CCS_ID_TRANSITION_CONTROL)
@@ -4683,7 +5765,7 @@ static void ccs_add_entry(char *header)
 	{
 		struct ccs_domain_info *domain = ccs_current_domain();
 		if (!ccs_write_acl(domain->ns, &domain->acl_info_list,
-				   buffer, false))
+				   buffer, false, false))
 			ccs_update_stat(CCS_STAT_POLICY_UPDATES);
 	}
 	kfree(buffer);
@@ -4710,7 +5792,7 @@ static bool ccs_domain_quota_ok(struct ccs_request_info *r)
 	list_for_each_entry_srcu(ptr, &domain->acl_info_list, list, &ccs_ss) {
 		u16 perm;
 		u8 i;
-		if (ptr->is_deleted)
+		if (ccs_deleted(ptr->is_deleted))
 			continue;
 		switch (ptr->type) {
 		case CCS_TYPE_PATH_ACL:
@@ -4846,6 +5928,8 @@ static int ccs_supervisor(struct ccs_request_info *r, const char *fmt, ...)
 		else
 			entry.timer++;
 	}
+	if (entry.timer == 10)
+		ccs_add_stat(perf[CCS_STAT_QUERY_TIMEOUT], 1);
 	spin_lock(&ccs_query_list_lock);
 	list_del(&entry.list);
 	ccs_memory_used[CCS_MEMORY_QUERY] -= len;
@@ -5116,21 +6200,17 @@ static void ccs_read_version(struct ccs_io_buffer *head)
  */
 static void ccs_update_stat(const u8 index)
 {
+	struct ccs_stat_counter *stat = &get_cpu_var(ccs_stat_counter);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 0)
 	struct timeval tv;
 	do_gettimeofday(&tv);
-	/*
-	 * I don't use atomic operations because race condition is not fatal.
-	 */
-	ccs_stat_updated[index]++;
-	ccs_stat_modified[index] = tv.tv_sec;
+	stat->updated[index]++;
+	stat->modified[index] = tv.tv_sec;
 #else
-	/*
-	 * I don't use atomic operations because race condition is not fatal.
-	 */
-	ccs_stat_updated[index]++;
-	ccs_stat_modified[index] = get_seconds();
+	stat->updated[index]++;
+	stat->modified[index] = get_seconds();
 #endif
+	put_cpu_var(ccs_stat_counter);
 }
 
 /**
@@ -5139,38 +6219,90 @@ static void ccs_update_stat(const u8 index)
  * @head: Pointer to "struct ccs_io_buffer".
  *
  * Returns nothing.
+ *
+ * Per-CPU counters are summed up without locking, so a line may be slightly
+ * out of date with respect to other lines.
  */
 static void ccs_read_stat(struct ccs_io_buffer *head)
 {
-	u8 i;
+	u16 i;
+	int cpu;
 	unsigned int total = 0;
 	if (head->r.eof)
 		return;
-	for (i = 0; i < CCS_MAX_POLICY_STAT; i++) {
-		ccs_io_printf(head, "Policy %-30s %10u", ccs_policy_headers[i],
-			      ccs_stat_updated[i]);
-		if (ccs_stat_modified[i]) {
-			struct ccs_time stamp;
-			ccs_convert_time(ccs_stat_modified[i], &stamp);
-			ccs_io_printf(head, " (Last: %04u/%02u/%02u "
-				      "%02u:%02u:%02u)",
-				      stamp.year, stamp.month, stamp.day,
-				      stamp.hour, stamp.min, stamp.sec);
+	switch (head->r.step) {
+	case 0:
+		for (i = 0; i < CCS_MAX_POLICY_STAT; i++) {
+			unsigned int updated = 0;
+			unsigned int modified = 0;
+			for_each_possible_cpu(cpu) {
+				const struct ccs_stat_counter *stat =
+					&per_cpu(ccs_stat_counter, cpu);
+				updated += stat->updated[i];
+				if (modified < stat->modified[i])
+					modified = stat->modified[i];
+			}
+			ccs_io_printf(head, "Policy %-30s %10u",
+				      ccs_policy_headers[i], updated);
+			if (modified) {
+				struct ccs_time stamp;
+				ccs_convert_time(modified, &stamp);
+				ccs_io_printf(head, " (Last: %04u/%02u/%02u "
+					      "%02u:%02u:%02u)",
+					      stamp.year, stamp.month,
+					      stamp.day, stamp.hour,
+					      stamp.min, stamp.sec);
+			}
+			ccs_set_lf(head);
+		}
+		for (i = 0; i < CCS_MAX_MEMORY_STAT; i++) {
+			unsigned int used = ccs_memory_used[i];
+			total += used;
+			ccs_io_printf(head, "Memory used by %-22s %10u",
+				      ccs_memory_headers[i], used);
+			used = ccs_memory_quota[i];
+			if (used)
+				ccs_io_printf(head, " (Quota: %10u)", used);
+			ccs_set_lf(head);
+		}
+		ccs_io_printf(head, "Total memory used:                    "
+			      "%10u\n", total);
+		head->r.step++;
+		head->r.index = 0;
+		/* fall through */
+	case 1:
+		while (head->r.index < CCS_MAX_PERF_STAT) {
+			unsigned long count = 0;
+			if (!ccs_flush(head))
+				return;
+			i = head->r.index++;
+			for_each_possible_cpu(cpu)
+				count += per_cpu(ccs_stat_counter, cpu).perf[i];
+			ccs_io_printf(head, "Counter %-29s %10lu\n",
+				      ccs_perf_headers[i], count);
+		}
+		head->r.step++;
+		head->r.index = 0;
+		/* fall through */
+	case 2:
+		while (head->r.index < CCS_MAX_MAC_INDEX) {
+			unsigned long count = 0;
+			char name[64];
+			if (!ccs_flush(head))
+				return;
+			i = head->r.index++;
+			for_each_possible_cpu(cpu)
+				count += per_cpu(ccs_stat_counter, cpu).
+					acl_check[i];
+			if (!count)
+				continue;
+			snprintf(name, sizeof(name), "%s::%s:",
+				 ccs_category_keywords[ccs_index2category[i]],
+				 ccs_mac_keywords[i]);
+			ccs_io_printf(head, "ACL check for %-23s %10lu\n",
+				      name, count);
 		}
-		ccs_set_lf(head);
-	}
-	for (i = 0; i < CCS_MAX_MEMORY_STAT; i++) {
-		unsigned int used = ccs_memory_used[i];
-		total += used;
-		ccs_io_printf(head, "Memory used by %-22s %10u",
-			      ccs_memory_headers[i], used);
-		used = ccs_memory_quota[i];
-		if (used)
-			ccs_io_printf(head, " (Quota: %10u)", used);
-		ccs_set_lf(head);
 	}
-	ccs_io_printf(head, "Total memory used:                    %10u\n",
-		      total);
 	head->r.eof = true;
 }
 
@@ -5196,32 +6328,150 @@ static int ccs_write_stat(struct ccs_io_buffer *head)
 	return 0;
 }
 
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+
+/**
+ * ccs_write_acl_profile - Start or stop updating "struct ccs_acl_counter".
+ *
+ * @head: Pointer to "struct ccs_io_buffer".
+ *
+ * Returns 0 on success, -EINVAL otherwise.
+ */
+static int ccs_write_acl_profile(struct ccs_io_buffer *head)
+{
+	const char *data = head->write_buf;
+	if (!strcmp(data, "enable"))
+		ccs_acl_profiling = true;
+	else if (!strcmp(data, "disable"))
+		ccs_acl_profiling = false;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+#endif
+
+#ifdef CONFIG_CCSECURITY_LATENCY
+
+/**
+ * ccs_record_latency - Count a latency into "struct ccs_latency_histogram".
+ *
+ * @index: One of values in "enum ccs_latency_index".
+ * @start: Value of local_clock() when the measured operation started.
+ *
+ * Returns nothing.
+ */
+void ccs_record_latency(const u8 index, const u64 start)
+{
+	s64 delta = local_clock() - start;
+	u8 slot = 0;
+	/* local_clock() of another CPU might be behind. */
+	if (delta > 1)
+		slot = min(fls64(delta) - 1, CCS_LATENCY_SLOTS - 1);
+	this_cpu_inc(ccs_latency_data->count[index][slot]);
+}
+
+/**
+ * ccs_read_latency - Read latency histograms.
+ *
+ * @head: Pointer to "struct ccs_io_buffer".
+ *
+ * Returns nothing.
+ *
+ * Each line consists of the name of a hook or a phase followed by
+ * "lower bound in nanoseconds:count" pairs of non-empty slots.
+ */
+static void ccs_read_latency(struct ccs_io_buffer *head)
+{
+	if (head->r.eof)
+		return;
+	while (ccs_latency_data && head->r.index < CCS_MAX_LATENCY) {
+		const u8 index = head->r.index;
+		u8 slot;
+		if (!ccs_flush(head))
+			return;
+		head->r.index++;
+		ccs_set_string(head, ccs_latency_keyword[index]);
+		for (slot = 0; slot < CCS_LATENCY_SLOTS; slot++) {
+			u64 count = 0;
+			int cpu;
+			for_each_possible_cpu(cpu)
+				count += per_cpu_ptr(ccs_latency_data, cpu)->
+					count[index][slot];
+			if (count)
+				ccs_io_printf(head, " %llu:%llu", slot ?
+					      1ULL << slot : 0ULL,
+					      (unsigned long long) count);
+		}
+		ccs_set_lf(head);
+	}
+	head->r.eof = true;
+}
+
+/**
+ * ccs_write_latency - Control latency histograms.
+ *
+ * @head: Pointer to "struct ccs_io_buffer".
+ *
+ * Returns 0 on success, negative value otherwise.
+ *
+ * "enable" starts recording, "disable" stops recording and "reset" clears
+ * histograms.
+ */
+static int ccs_write_latency(struct ccs_io_buffer *head)
+{
+	const char *data = head->write_buf;
+	int cpu;
+	if (!strcmp(data, "enable")) {
+		if (!ccs_latency_data) {
+			ccs_latency_data =
+				alloc_percpu(struct ccs_latency_histogram);
+			if (!ccs_latency_data)
+				return -ENOMEM;
+		}
+		static_branch_enable(&ccs_latency_enabled);
+	} else if (!strcmp(data, "disable")) {
+		static_branch_disable(&ccs_latency_enabled);
+	} else if (!strcmp(data, "reset")) {
+		if (ccs_latency_data)
+			for_each_possible_cpu(cpu)
+				memset(per_cpu_ptr(ccs_latency_data, cpu), 0,
+				       sizeof(struct ccs_latency_histogram));
+	} else {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+#endif
+
 /**
  * ccs_print_bprm - Print "struct linux_binprm" for auditing.
  *
- * @bprm: Pointer to "struct linux_binprm".
- * @dump: Pointer to "struct ccs_page_dump".
+ * @ee: Pointer to "struct ccs_execve".
  *
- * Returns the contents of @bprm on success, NULL otherwise.
+ * Returns the contents of @ee->bprm on success, NULL otherwise.
  *
  * This function uses kzalloc(), so caller must kfree() if this function
  * didn't return NULL.
  */
-static char *ccs_print_bprm(struct linux_binprm *bprm,
-			    struct ccs_page_dump *dump)
+static char *ccs_print_bprm(struct ccs_execve *ee)
 {
 	static const int ccs_buffer_len = 4096 * 2;
 	char *buffer = kzalloc(ccs_buffer_len, CCS_GFP_FLAGS);
+	const struct ccs_bprm_strings *strings;
 	char *cp;
 	char *last_start;
 	int len;
-	unsigned long pos = bprm->p;
-	int offset = pos % PAGE_SIZE;
-	int argv_count = bprm->argc;
-	int envp_count = bprm->envc;
+	size_t offset = 0;
+	int argv_count = ee->bprm->argc;
+	int envp_count = ee->bprm->envc;
 	bool truncated = false;
 	if (!buffer)
 		return NULL;
+	strings = ccs_load_bprm(ee);
+	if (!strings)
+		goto out;
 	len = snprintf(buffer, ccs_buffer_len - 1, "argv[]={ ");
 	cp = buffer + len;
 	if (!argv_count) {
@@ -5229,61 +6479,52 @@ static char *ccs_print_bprm(struct linux_binprm *bprm,
 		cp += 11;
 	}
 	last_start = cp;
-	while (argv_count || envp_count) {
-		if (!ccs_dump_page(bprm, pos, dump))
-			goto out;
-		pos += PAGE_SIZE - offset;
-		/* Read. */
-		while (offset < PAGE_SIZE) {
-			const char *kaddr = dump->data;
-			const unsigned char c = kaddr[offset++];
-			if (cp == last_start)
-				*cp++ = '"';
-			if (cp >= buffer + ccs_buffer_len - 32) {
-				/* Reserve some room for "..." string. */
-				truncated = true;
-			} else if (c == '\\') {
-				*cp++ = '\\';
-				*cp++ = '\\';
-			} else if (c > ' ' && c < 127) {
-				*cp++ = c;
-			} else if (!c) {
-				*cp++ = '"';
-				*cp++ = ' ';
+	/* Read. */
+	while ((argv_count || envp_count) && offset < strings->len) {
+		const unsigned char c = strings->data[offset++];
+		if (cp == last_start)
+			*cp++ = '"';
+		if (cp >= buffer + ccs_buffer_len - 32) {
+			/* Reserve some room for "..." string. */
+			truncated = true;
+		} else if (c == '\\') {
+			*cp++ = '\\';
+			*cp++ = '\\';
+		} else if (c > ' ' && c < 127) {
+			*cp++ = c;
+		} else if (!c) {
+			*cp++ = '"';
+			*cp++ = ' ';
+			last_start = cp;
+		} else {
+			*cp++ = '\\';
+			*cp++ = (c >> 6) + '0';
+			*cp++ = ((c >> 3) & 7) + '0';
+			*cp++ = (c & 7) + '0';
+		}
+		if (c)
+			continue;
+		if (argv_count) {
+			if (--argv_count == 0) {
+				if (truncated) {
+					cp = last_start;
+					memmove(cp, "... ", 4);
+					cp += 4;
+				}
+				memmove(cp, "} envp[]={ ", 11);
+				cp += 11;
 				last_start = cp;
-			} else {
-				*cp++ = '\\';
-				*cp++ = (c >> 6) + '0';
-				*cp++ = ((c >> 3) & 7) + '0';
-				*cp++ = (c & 7) + '0';
+				truncated = false;
 			}
-			if (c)
-				continue;
-			if (argv_count) {
-				if (--argv_count == 0) {
-					if (truncated) {
-						cp = last_start;
-						memmove(cp, "... ", 4);
-						cp += 4;
-					}
-					memmove(cp, "} envp[]={ ", 11);
-					cp += 11;
-					last_start = cp;
-					truncated = false;
-				}
-			} else if (envp_count) {
-				if (--envp_count == 0) {
-					if (truncated) {
-						cp = last_start;
-						memmove(cp, "... ", 4);
-						cp += 4;
-					}
+		} else if (envp_count) {
+			if (--envp_count == 0) {
+				if (truncated) {
+					cp = last_start;
+					memmove(cp, "... ", 4);
+					cp += 4;
 				}
 			}
-			if (!argv_count && !envp_count)
-				break;
 		}
-		offset = 0;
 	}
 	*cp++ = '}';
 	*cp = '\0';
@@ -5377,10 +6618,8 @@ static char *ccs_print_header(struct ccs_request_info *r)
 		       ccs_flags & CCS_TASK_IS_EXECUTE_HANDLER ? "" : "!");
 	if (!obj)
 		goto no_obj_info;
-	if (!obj->validate_done) {
-		ccs_get_attributes(obj);
-		obj->validate_done = true;
-	}
+	/* The header prints every slot. */
+	ccs_get_attributes(obj, (1 << CCS_MAX_PATH_STAT) - 1);
 	for (i = 0; i < CCS_MAX_PATH_STAT; i++) {
 		struct ccs_mini_stat *stat;
 		unsigned int dev;
@@ -5459,7 +6698,7 @@ static char *ccs_init_log(struct ccs_request_info *r, int len, const char *fmt,
 #else
 		realpath = ccs_realpath(&file->f_path);
 #endif
-		bprm_info = ccs_print_bprm(r->ee->bprm, &r->ee->dump);
+		bprm_info = ccs_print_bprm(r->ee);
 		if (!realpath || !bprm_info)
 			goto out;
 		/* +80 is for " exec={ realpath=\"%s\" argc=%d envc=%d %s }" */
@@ -5564,8 +6803,6 @@ static bool ccs_get_audit(const struct ccs_request_info *r)
 	if (!ccs_policy_loaded)
 		return false;
 	p = ccs_profile(profile);
-	if (ccs_log_count >= p->pref[CCS_PREF_MAX_AUDIT_LOG])
-		return false;
 	if (is_granted && matched_acl && matched_acl->cond &&
 	    matched_acl->cond->grant_log != CCS_GRANTLOG_AUTO)
 		return matched_acl->cond->grant_log == CCS_GRANTLOG_YES;
@@ -5598,13 +6835,16 @@ static void ccs_write_log2(struct ccs_request_info *r, int len,
 	bool quota_exceeded = false;
 	if (!ccs_get_audit(r))
 		goto out;
+	if (ccs_log_count >=
+	    ccs_profile(r->profile)->pref[CCS_PREF_MAX_AUDIT_LOG])
+		goto drop;
 	buf = ccs_init_log(r, len, fmt, args);
 	if (!buf)
-		goto out;
+		goto drop;
 	entry = kzalloc(sizeof(*entry), CCS_GFP_FLAGS);
 	if (!entry) {
 		kfree(buf);
-		goto out;
+		goto drop;
 	}
 	entry->log = buf;
 	len = ccs_round2(strlen(buf) + 1);
@@ -5627,9 +6867,12 @@ static void ccs_write_log2(struct ccs_request_info *r, int len,
 	if (quota_exceeded) {
 		kfree(buf);
 		kfree(entry);
-		goto out;
+		goto drop;
 	}
 	wake_up(&ccs_log_wait);
+	goto out;
+drop:
+	ccs_add_stat(perf[CCS_STAT_AUDIT_DROPPED], 1);
 out:
 	ccs_update_task_domain(r);
 }
@@ -5805,7 +7048,7 @@ static bool ccs_namespace_jump(const char *domainname)
 }
 
 /**
- * ccs_assign_domain - Create a domain or a namespace.
+ * __ccs_assign_domain - Create a domain or a namespace.
  *
  * @domainname: The name of domain.
  * @transit:    True if transit to domain found or created.
@@ -5814,8 +7057,8 @@ static bool ccs_namespace_jump(const char *domainname)
  *
  * Caller holds ccs_read_lock().
  */
-struct ccs_domain_info *ccs_assign_domain(const char *domainname,
-					  const bool transit)
+static struct ccs_domain_info *__ccs_assign_domain(const char *domainname,
+						   const bool transit)
 {
 	struct ccs_security *security = ccs_current_security();
 	struct ccs_domain_info e = { };
@@ -5832,7 +7075,7 @@ struct ccs_domain_info *ccs_assign_domain(const char *domainname,
 			if (ccs_policy_loaded &&
 			    !entry->ns->profile_ptr[entry->profile])
 				return NULL;
-			security->ccs_domain_info = entry;
+			ccs_set_domain(security, entry);
 		}
 		return entry;
 	}
@@ -5871,7 +7114,9 @@ struct ccs_domain_info *ccs_assign_domain(const char *domainname,
 	if (!entry) {
 		entry = ccs_commit_ok(&e, sizeof(e));
 		if (entry) {
+			static unsigned int ccs_domain_serial;
 			INIT_LIST_HEAD(&entry->acl_info_list);
+			entry->serial = ++ccs_domain_serial;
 			list_add_tail_rcu(&entry->list, &ccs_domain_list);
 			created = true;
 		}
@@ -5880,7 +7125,7 @@ struct ccs_domain_info *ccs_assign_domain(const char *domainname,
 out:
 	ccs_put_name(e.domainname);
 	if (entry && transit) {
-		security->ccs_domain_info = entry;
+		ccs_set_domain(security, entry);
 		if (created) {
 			struct ccs_request_info r;
 			int i;
@@ -5896,6 +7141,181 @@ out:
 	return entry;
 }
 
+/**
+ * ccs_assign_domain - Create a domain or a namespace.
+ *
+ * @domainname: The name of domain.
+ * @transit:    True if transit to domain found or created.
+ *
+ * Returns pointer to "struct ccs_domain_info" on success, NULL otherwise.
+ *
+ * Caller holds ccs_read_lock().
+ */
+struct ccs_domain_info *ccs_assign_domain(const char *domainname,
+					  const bool transit)
+{
+	const u64 start = trace_ccs_assign_domain_enabled() ?
+		ccs_trace_clock() : 0;
+	struct ccs_domain_info *entry =
+		__ccs_assign_domain(domainname, transit);
+	if (trace_ccs_assign_domain_enabled())
+		trace_ccs_assign_domain(domainname, entry, transit,
+					ccs_trace_clock() - start);
+	return entry;
+}
+
+/**
+ * ccs_begin_txn - Begin a transaction.
+ *
+ * @head: Pointer to "struct ccs_io_buffer".
+ *
+ * Returns 0 on success, negative value otherwise.
+ *
+ * Until @head commits or aborts, lines written to @head are staged without
+ * becoming visible to readers, and other writers get -EBUSY.
+ *
+ * The transaction takes a slot which is not in ccs_txn_busy, thus it need
+ * not wait for the garbage collector to forget the previous transaction.
+ * -EBUSY is returned only if all CCS_TXN_SLOTS slots ended within an SRCU
+ * grace period.
+ */
+static int ccs_begin_txn(struct ccs_io_buffer *head)
+{
+	int error = -EBUSY;
+	u8 i;
+	if (mutex_lock_interruptible(&ccs_policy_lock))
+		return -ENOMEM;
+	for (i = 1; !ccs_txn_owner && i <= CCS_TXN_SLOTS; i++) {
+		const u8 slot = (ccs_txn_slot + i) % CCS_TXN_SLOTS;
+		if (ccs_txn_busy & (1 << slot))
+			continue;
+		ccs_txn_slot = slot;
+		ccs_txn_owner = head;
+		error = 0;
+	}
+	mutex_unlock(&ccs_policy_lock);
+	return error;
+}
+
+/**
+ * ccs_settle_txn - Turn CCS_TXN_* states in a list into false or true.
+ *
+ * @ns:     Pointer to "struct ccs_policy_namespace" which @list belongs to.
+ * @list:   Pointer to "struct list_head".
+ * @is_acl: True if @list is a list of "struct ccs_acl_info", false if @list
+ *          is a list of "struct ccs_acl_head".
+ * @commit: True if the transaction was committed, false if aborted.
+ *
+ * Returns true if @list had an entry in CCS_TXN_* state, false otherwise.
+ *
+ * Caller holds ccs_policy_lock mutex.
+ */
+static bool ccs_settle_txn(struct ccs_policy_namespace *ns,
+			   struct list_head *list, const bool is_acl,
+			   const bool commit)
+{
+	struct list_head *pos;
+	bool found = false;
+	list_for_each(pos, list) {
+		s8 *is_deleted = is_acl ?
+			&container_of(pos, struct ccs_acl_info, list)->
+			is_deleted :
+			&container_of(pos, struct ccs_acl_head, list)->
+			is_deleted;
+		if (*is_deleted <= true)
+			continue;
+		found = true;
+		*is_deleted = (*is_deleted == CCS_TXN_ADDED) != commit;
+		if (*is_deleted)
+			ccs_mark_garbage(ns, list, is_acl);
+	}
+#ifdef CONFIG_CCSECURITY_ACL_TABLE
+	if (found && is_acl)
+		ccs_touch_acl_list(ns, list);
+#endif
+	return found;
+}
+
+/**
+ * ccs_end_txn - Commit or abort a transaction.
+ *
+ * @head:   Pointer to "struct ccs_io_buffer".
+ * @commit: True if commit, false if abort.
+ *
+ * Returns 0 on success, negative value otherwise.
+ *
+ * Setting ccs_txn_committed[] is the single point where readers switch to
+ * new policy. Caches derived from old policy are invalidated before that
+ * point, so that no reader uses them together with new policy. Then,
+ * CCS_TXN_* states are turned into false or true, and the garbage collector
+ * clears ccs_txn_committed[] and ccs_txn_busy after an SRCU grace period.
+ */
+static int ccs_end_txn(struct ccs_io_buffer *head, const bool commit)
+{
+	struct ccs_policy_namespace *ns;
+	struct ccs_domain_info *domain;
+#ifdef CONFIG_CCSECURITY_PORTRESERVE
+	bool port_modified = false;
+#endif
+	unsigned int i;
+	mutex_lock(&ccs_policy_lock);
+	if (ccs_txn_owner != head) {
+		mutex_unlock(&ccs_policy_lock);
+		return -EINVAL;
+	}
+	if (commit) {
+		ccs_acl_generation++;
+		smp_wmb(); /* Avoid out-of-order execution. */
+		ccs_txn_committed[ccs_txn_slot] = true;
+		smp_wmb(); /* Avoid out-of-order execution. */
+	}
+	/*
+	 * Results which readers cached between the above increment and the
+	 * commit might be based on old policy. Also, indexes skip entries in
+	 * CCS_TXN_* states.
+	 */
+	ccs_acl_generation++;
+	list_for_each_entry(ns, &ccs_namespace_list, namespace_list) {
+		for (i = 0; i < CCS_MAX_POLICY; i++) {
+			if (!ccs_settle_txn(ns, &ns->policy_list[i], false,
+					    commit))
+				continue;
+#ifdef CONFIG_CCSECURITY_PORTRESERVE
+			if (i == CCS_ID_RESERVEDPORT)
+				port_modified = true;
+#endif
+		}
+		for (i = 0; i < CCS_MAX_ACL_GROUPS; i++)
+			ccs_settle_txn(ns, &ns->acl_group[i], true, commit);
+		for (i = 0; i < CCS_MAX_GROUP; i++) {
+			struct ccs_group *group;
+			list_for_each_entry(group, &ns->group_list[i],
+					    head.list)
+				ccs_settle_txn(ns, &group->member_list, false,
+					       commit);
+		}
+	}
+	list_for_each_entry(domain, &ccs_domain_list, list)
+		ccs_settle_txn(domain->ns, &domain->acl_info_list, true,
+			       commit);
+	ccs_txn_owner = NULL;
+	/*
+	 * Readers might still be checking CCS_TXN_* states of this slot even
+	 * if aborted. Don't reuse this slot until they are gone.
+	 */
+	ccs_txn_busy |= 1 << ccs_txn_slot;
+	set_bit(CCS_GC_DIRTY_TXN, &ccs_gc_dirty);
+	mutex_unlock(&ccs_policy_lock);
+	ccs_schedule_gc();
+	if (!commit)
+		return 0;
+#ifdef CONFIG_CCSECURITY_PORTRESERVE
+	if (port_modified)
+		return ccs_set_reserved_ports();
+#endif
+	return 0;
+}
+
 /**
  * ccs_parse_policy - Parse a policy line.
  *
@@ -5908,6 +7328,16 @@ out:
  */
 static int ccs_parse_policy(struct ccs_io_buffer *head, char *line)
 {
+	/* Transaction request? */
+	if (head->type == CCS_DOMAIN_POLICY ||
+	    head->type == CCS_EXCEPTION_POLICY) {
+		if (!strcmp(line, "begin"))
+			return ccs_begin_txn(head);
+		if (!strcmp(line, "commit"))
+			return ccs_end_txn(head, true);
+		if (!strcmp(line, "abort"))
+			return ccs_end_txn(head, false);
+	}
 	/* Delete request? */
 	head->w.is_delete = !strncmp(line, "delete ", 7);
 	if (head->w.is_delete)
@@ -5947,6 +7377,14 @@ static int ccs_parse_policy(struct ccs_io_buffer *head, char *line)
 		return ccs_write_answer(head);
 	case CCS_MANAGER:
 		return ccs_write_manager(head);
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+	case CCS_ACL_PROFILE:
+		return ccs_write_acl_profile(head);
+#endif
+#ifdef CONFIG_CCSECURITY_LATENCY
+	case CCS_LATENCY:
+		return ccs_write_latency(head);
+#endif
 	default:
 		return -ENOSYS;
 	}
@@ -5959,6 +7397,11 @@ static int ccs_parse_policy(struct ccs_io_buffer *head, char *line)
  */
 static void __init ccs_policy_io_init(void)
 {
+	unsigned int idx;
+	for (idx = 0; idx < CCS_MAX_DEDUP_HASH; idx++)
+		INIT_LIST_HEAD(&ccs_dedup_index_list[idx]);
+	for (idx = 0; idx < CCS_MAX_CONDITION_HASH; idx++)
+		INIT_LIST_HEAD(&ccs_condition_list[idx]);
 	ccsecurity_ops.check_profile = ccs_check_profile;
 }
 
@@ -6124,6 +7567,10 @@ static int ccs_release(struct inode *inode, struct file *file)
 	if (head->type == CCS_QUERY &&
 	    atomic_dec_and_test(&ccs_query_observers))
 		wake_up_all(&ccs_answer_wait);
+	/* Abort the transaction which was not committed. */
+	if (head->type == CCS_DOMAIN_POLICY ||
+	    head->type == CCS_EXCEPTION_POLICY)
+		ccs_end_txn(head, false);
 	ccs_notify_gc(head, false);
 	return 0;
 }
@@ -6172,17 +7619,22 @@ static ssize_t ccs_read(struct file *file, char __user *buf, size_t count,
 	struct ccs_io_buffer *head = file->private_data;
 	int len;
 	int idx;
+	int error = 0;
 	if (mutex_lock_interruptible(&head->io_sem))
 		return -EINTR;
 	head->read_user_buf = buf;
 	head->read_user_buf_avail = count;
 	idx = ccs_read_lock();
+	ccs_lock_cursor();
 	if (ccs_flush(head))
 		/* Call the policy handler. */
 		do {
 			ccs_set_namespace_cursor(head);
 			switch (head->type) {
 			case CCS_DOMAIN_POLICY:
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+			case CCS_ACL_PROFILE:
+#endif
 				ccs_read_domain(head);
 				break;
 			case CCS_EXCEPTION_POLICY:
@@ -6212,10 +7664,17 @@ static ssize_t ccs_read(struct file *file, char __user *buf, size_t count,
 			case CCS_MANAGER:
 				ccs_read_manager(head);
 				break;
+#ifdef CONFIG_CCSECURITY_LATENCY
+			case CCS_LATENCY:
+				ccs_read_latency(head);
+				break;
+#endif
 			}
 		} while (ccs_flush(head) && ccs_has_more_namespace(head));
+	if (ccs_unlock_cursor(head))
+		error = -ENOMEM;
 	ccs_read_unlock(idx);
-	len = head->read_user_buf - buf;
+	len = error ? error : head->read_user_buf - buf;
 	mutex_unlock(&head->io_sem);
 	return len;
 }
@@ -6303,6 +7762,12 @@ static ssize_t ccs_write(struct file *file, const char __user *buf,
 	if (mutex_lock_interruptible(&head->io_sem))
 		return -EINTR;
 	head->read_user_buf_avail = 0;
+	/*
+	 * Writers never walk from pinned cursors. They only assign cursors to
+	 * elements found under ccs_read_lock(), and ccs_pin_cursor() pins them
+	 * before ccs_read_unlock(). Thus, ccs_lock_cursor() is not needed, and
+	 * the garbage collector is not blocked while the policy is loaded.
+	 */
 	idx = ccs_read_lock();
 	/* Read a line and dispatch it to the policy handler. */
 	while (count) {
@@ -6332,7 +7797,12 @@ static ssize_t ccs_write(struct file *file, const char __user *buf,
 		cp0[head->w.avail - 1] = '\0';
 		head->w.avail = 0;
 		ccs_normalize_line(cp0);
-		if (!strcmp(cp0, "reset")) {
+		if (!strcmp(cp0, "reset")
+#ifdef CONFIG_CCSECURITY_LATENCY
+		    /* "reset" clears histograms of /proc/ccs/latency . */
+		    && head->type != CCS_LATENCY
+#endif
+		    ) {
 			head->w.ns = &ccs_kernel_namespace;
 			head->w.domain = NULL;
 			memset(&head->r, 0, sizeof(head->r));
@@ -6380,6 +7850,8 @@ static ssize_t ccs_write(struct file *file, const char __user *buf,
 		}
 	}
 out:
+	if (ccs_pin_cursor(head) && error >= 0)
+		error = -ENOMEM;
 	ccs_read_unlock(idx);
 	mutex_unlock(&head->io_sem);
 	return error;
@@ -6448,6 +7920,12 @@ static void __init ccs_proc_init(void)
 	ccs_create_entry(".execute_handler", 0666, ccs_dir,
 			 CCS_EXECUTE_HANDLER);
 #endif
+#ifdef CONFIG_CCSECURITY_ACL_PROFILE
+	ccs_create_entry("acl_profile",      0600, ccs_dir, CCS_ACL_PROFILE);
+#endif
+#ifdef CONFIG_CCSECURITY_LATENCY
+	ccs_create_entry("latency",          0600, ccs_dir, CCS_LATENCY);
+#endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 26)
 	proc_create("self_domain", 0666, ccs_dir, &ccs_self_operations);
 #else
@@ -6481,6 +7959,7 @@ static int __init ccs_init_module(void)
 	ccs_kernel_domain.ns = &ccs_kernel_namespace;
 	INIT_LIST_HEAD(&ccs_kernel_domain.acl_info_list);
 	ccs_mm_init();
+	ccs_gc_init();
 	ccs_policy_io_init();
 	ccs_permission_init();
 	ccs_proc_init();
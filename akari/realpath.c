@@ -514,8 +514,11 @@ char *ccs_realpath(const struct path *path)
 	unsigned int buf_len = PAGE_SIZE / 2;
 	struct dentry *dentry = path->dentry;
 	struct super_block *sb;
+	u64 start;
 	if (!dentry)
 		return NULL;
+	ccs_add_stat(perf[CCS_STAT_REALPATH], 1);
+	start = ccs_latency_start();
 	sb = dentry->d_sb;
 	while (1) {
 		char *pos;
@@ -578,6 +581,7 @@ encode:
 		break;
 	}
 	kfree(buf);
+	ccs_latency_end(CCS_LATENCY_REALPATH, start);
 	if (!name)
 		ccs_warn_oom(__func__);
 	return name;
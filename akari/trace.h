@@ -0,0 +1,182 @@
+/*
+ * trace.h
+ *
+ * Tracepoints for permission decisions and domain transitions.
+ *
+ * Events are recorded into the ftrace ring buffer without going through
+ * /proc/ccs/audit . If tracepoints are not available, trace_ccs_*() are
+ * no-op stubs.
+ */
+
+#ifdef CONFIG_CCSECURITY_TRACEPOINT
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM akari
+
+#if !defined(_CCS_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _CCS_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#ifndef ccs_assign_str
+/* Start time of an event. Called only if the event is enabled. */
+#define ccs_trace_clock() local_clock()
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+#define ccs_assign_str(dst, src) __assign_str(dst)
+#else
+#define ccs_assign_str(dst, src) __assign_str(dst, src)
+#endif
+#endif
+
+/* Verdict of ccs_check_acl(). */
+TRACE_EVENT(ccs_permission,
+
+	TP_PROTO(const u8 type, const void *domain, const char *domainname,
+		 const char *path, const bool granted, const int error,
+		 const u64 duration),
+
+	TP_ARGS(type, domain, domainname, path, granted, error, duration),
+
+	TP_STRUCT__entry(
+		__field(u8, type)
+		__field(const void *, domain)
+		__string(domainname, domainname)
+		__string(path, path)
+		__field(bool, granted)
+		__field(int, error)
+		__field(u64, duration)
+	),
+
+	TP_fast_assign(
+		__entry->type = type;
+		__entry->domain = domain;
+		ccs_assign_str(domainname, domainname);
+		ccs_assign_str(path, path);
+		__entry->granted = granted;
+		__entry->error = error;
+		__entry->duration = duration;
+	),
+
+	TP_printk("type=%u domain=%p domainname=\"%s\" path=\"%s\" granted=%d error=%d duration=%llu",
+		  __entry->type, __entry->domain, __get_str(domainname),
+		  __get_str(path), __entry->granted, __entry->error,
+		  (unsigned long long) __entry->duration)
+);
+
+/* Result of ccs_find_next_domain(). */
+TRACE_EVENT(ccs_domain_transition,
+
+	TP_PROTO(const void *old_domain, const char *old_domainname,
+		 const void *new_domain, const char *new_domainname,
+		 const char *path, const int error, const u64 duration),
+
+	TP_ARGS(old_domain, old_domainname, new_domain, new_domainname, path,
+		error, duration),
+
+	TP_STRUCT__entry(
+		__field(const void *, old_domain)
+		__string(old_domainname, old_domainname)
+		__field(const void *, new_domain)
+		__string(new_domainname, new_domainname)
+		__string(path, path)
+		__field(int, error)
+		__field(u64, duration)
+	),
+
+	TP_fast_assign(
+		__entry->old_domain = old_domain;
+		ccs_assign_str(old_domainname, old_domainname);
+		__entry->new_domain = new_domain;
+		ccs_assign_str(new_domainname, new_domainname);
+		ccs_assign_str(path, path);
+		__entry->error = error;
+		__entry->duration = duration;
+	),
+
+	TP_printk("old=%p old_domainname=\"%s\" new=%p new_domainname=\"%s\" path=\"%s\" error=%d duration=%llu",
+		  __entry->old_domain, __get_str(old_domainname),
+		  __entry->new_domain, __get_str(new_domainname),
+		  __get_str(path), __entry->error,
+		  (unsigned long long) __entry->duration)
+);
+
+/* Result of ccs_assign_domain(). */
+TRACE_EVENT(ccs_assign_domain,
+
+	TP_PROTO(const char *domainname, const void *domain, const bool transit,
+		 const u64 duration),
+
+	TP_ARGS(domainname, domain, transit, duration),
+
+	TP_STRUCT__entry(
+		__string(domainname, domainname)
+		__field(const void *, domain)
+		__field(bool, transit)
+		__field(u64, duration)
+	),
+
+	TP_fast_assign(
+		ccs_assign_str(domainname, domainname);
+		__entry->domain = domain;
+		__entry->transit = transit;
+		__entry->duration = duration;
+	),
+
+	TP_printk("domainname=\"%s\" domain=%p transit=%d duration=%llu",
+		  __get_str(domainname), __entry->domain, __entry->transit,
+		  (unsigned long long) __entry->duration)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+#include <trace/define_trace.h>
+
+#elif !defined(_CCS_TRACE_H)
+#define _CCS_TRACE_H
+
+#define ccs_trace_clock() 0
+
+static inline bool trace_ccs_permission_enabled(void)
+{
+	return false;
+}
+
+static inline void trace_ccs_permission(const u8 type, const void *domain,
+					const char *domainname,
+					const char *path, const bool granted,
+					const int error, const u64 duration)
+{
+}
+
+static inline bool trace_ccs_domain_transition_enabled(void)
+{
+	return false;
+}
+
+static inline void trace_ccs_domain_transition(const void *old_domain,
+					       const char *old_domainname,
+					       const void *new_domain,
+					       const char *new_domainname,
+					       const char *path,
+					       const int error,
+					       const u64 duration)
+{
+}
+
+static inline bool trace_ccs_assign_domain_enabled(void)
+{
+	return false;
+}
+
+static inline void trace_ccs_assign_domain(const char *domainname,
+					   const void *domain,
+					   const bool transit,
+					   const u64 duration)
+{
+}
+
+#endif